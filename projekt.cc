@@ -15,89 +15,1271 @@
 #include "ns3/gnuplot.h"
 #include "ns3/rng-seed-manager.h"
 #include "ns3/aodv-helper.h"
+#include "ns3/spectrum-channel.h"
+#include "ns3/spectrum-wifi-helper.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/llc-snap-header.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/arp-l3-protocol.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/node-list.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/global-value.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/ppp-header.h"
 #include <math.h>
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace ns3;
 
 void runSim(double);
-void fillGnuplotData(std::vector<int> meassurements[]);
-void fillGnuplotData(std::vector<double> meassurements[]);
-void fillGnuplotData(std::vector<int> meassurements[], std::vector<double> xValues);
-void fillGnuplotData(std::vector<double> meassurements[], std::vector<double> xValues);
-void aggregatePacketCount(std::vector<double> packetArrivalTimes, std::vector<int> meassurementsArray[], uint64_t index);
+static void steadyStateMonitor(double simulationTime);
+static bool windowsAgree(const std::vector<int> &bins, size_t end, size_t width);
+struct GraphOutput;
+struct SimulationConfig;
+struct TimedEvent;
+void setupGraph(GraphOutput &graph, int id);
+std::vector<SimulationConfig> graphConfigurations(int graph);
+static std::string graphLabel(int graph);
+static bool parseConfig(const std::string &text, SimulationConfig &config);
+static bool parseEvents(const std::string &text, std::vector<TimedEvent> &events);
+std::vector<int> parseList(const std::string &text);
+static bool loadScenario(const std::string &fileName, std::vector<std::string> &args);
+bool sameConfig(const SimulationConfig &a, const SimulationConfig &b);
+static std::string configLabel(const SimulationConfig &config);
+size_t findConfig(const std::vector<SimulationConfig> &configs, const SimulationConfig &config);
+struct RunningStats;
+void fillGnuplotData(GraphOutput &graph, const std::vector<RunningStats> &points, const std::vector<double> &xValues);
+static void setLabels(GraphOutput &graph, const std::string &title, const std::string &xLabel, const std::string &yLabel);
+static void addPlotSeries(GraphOutput &graph, const std::string &title);
+static pid_t startGnuplot(const std::vector<std::string> &plotFiles, const std::string &batchName);
+bool writeSvgGraph(const GraphOutput &graph, const std::string &fileName);
+struct SimulationTask;
+struct ReplicateResult;
+static void buildGraph(GraphOutput &graph, const std::vector<SimulationConfig> &configs, const std::vector<size_t> &configRuns,
+        const std::vector<std::vector<size_t> > &configReplicates, const std::vector<ReplicateResult> &simulatedResults);
+std::vector<double> graphSeries(int graph, const ReplicateResult &result);
+static double steadyTotal(uint64_t total, const std::vector<int> &bins, const ReplicateResult &result, double until);
+static std::vector<double> steadyBins(const std::vector<int> &bins, const ReplicateResult &result, double until);
+void addSeries(std::vector<RunningStats> &points, const std::vector<double> &series);
+size_t convergedRuns(const SimulationConfig &config, const std::vector<ReplicateResult> &results, const std::vector<size_t> &replicates);
+std::vector<uint64_t> refineSweep(const std::vector<RunningStats> &points, size_t maxPoints);
+bool runReplicates(const std::vector<SimulationTask> &tasks, double simulationTime, std::vector<ReplicateResult> &results);
+static bool runPool(const std::vector<SimulationTask> &tasks, const std::vector<size_t> &pending, double simulationTime, std::vector<ReplicateResult> &results);
+static void resetMeasurements(double simulationTime);
+static void writeStoredResult(const SimulationTask &task, const ReplicateResult &result, double simulationTime);
+static bool loadStore(const std::vector<SimulationConfig> &configs, double simulationTime, std::vector<SimulationTask> &tasks,
+        std::vector<ReplicateResult> &results, std::vector<std::vector<size_t> > &configReplicates);
+static void assignStreams(const SimulationConfig &config);
+void writeLatencyReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results);
+static void writeLatencyLine(std::ostream &out, const SimulationTask &task, std::vector<ReplicateResult>::const_iterator begin,
+        std::vector<ReplicateResult>::const_iterator end, int64_t replicate);
+void writeOverheadReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results);
+void writeHandoverReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results);
+static void writeDistribution(std::ostream &out, const std::string &routing, const std::string &metric, std::vector<double> values);
+bool runCalibration(const std::vector<SimulationConfig> &configs, uint64_t nRuns, double simulationTime);
+static std::string schedulerType(const std::string &name);
+bool runSchedulerBench(double simulationTime);
+static void addCounts(std::vector<double> &sum, const std::vector<uint64_t> &counts);
+struct PhaseMeasurement;
+void writeBenchReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results,
+        const PhaseMeasurement &simulatePhase, const PhaseMeasurement &aggregationPhase, const PhaseMeasurement &plotPhase);
 
 // global variables / simulation settings
 bool logRobotCallback = false;
 bool doNetanim = false;
-int makeGraph = 0;
-int simTime = 30;
-Gnuplot2dDataset data;
-Gnuplot2dDataset errorBars;
+
+// NetAnim output for long runs: only the given time window, mobility sampled every animMobilityInterval,
+// packets optional and the file stopped once it grows past animMaxMb
+std::string animFile = "netanim.xml";
+double animStart = 0.0;
+double animStop = 0.0; // 0 for the end of the simulation
+double animMobilityInterval = 0.25;
+bool animPackets = true;
+bool animMetadata = true;
+double animMaxMb = 0.0; // 0 for no limit
+// the animation animMaxMb applies to, checked every animMobilityInterval and every animCheckFrames transmitted frames
+AnimationInterface *animLimited = NULL;
+uint32_t animFramesSinceCheck = 0;
+const uint32_t animCheckFrames = 64;
+
+std::vector<int> graphs; // graphs generated by this invocation
+double binWidth = 1.0; // width of one measurement bin in seconds
+bool keepArrivalTimes = false; // raw timestamps are only stored when asked for
+
+// one generated graph, grafN.plt and grafN.svg
+struct PlotSeries {
+    std::string title;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> deviation; // empty when the series has no error bars
+};
+
+struct GraphOutput {
+    int id;
+    Gnuplot plot;
+    Gnuplot2dDataset data;
+    Gnuplot2dDataset errorBars;
+    std::vector<Gnuplot2dDataset> percentiles; // graph 12 plots these instead of data and errorBars
+
+    // the same graph for the direct SVG writer
+    std::string title;
+    std::string xLabel;
+    std::string yLabel;
+    bool logX;
+    double xMin, xMax; // the range of the data when xMin == xMax
+    std::vector<PlotSeries> series;
+};
+const int nGraphs = 12;
+
+// gnuplot: the .plt files of all graphs are rendered by one gnuplot process in the background,
+// svg: the graphs are written directly, none: only the .plt files are written
+std::string plotter = "gnuplot";
+
+// replicates are run in forked worker processes, replicate i uses RNG run firstRun + i
+int nJobs = 1;
+uint64_t firstRun = 1;
+
+// the applications start once routing has converged; with warmStart that prefix is simulated once per
+// configuration (RNG run firstRun) and every replicate is forked from it with new random streams
+double appStartTime = 3.0;
+bool warmStart = false;
+
+// replicates per configuration; with targetRelErr > 0 more are run (up to maxRuns) until the 95% confidence
+// interval of every plotted point is within targetRelErr of its mean
+uint64_t runs = 10;
+double targetRelErr = 0.0;
+uint64_t maxRuns = 100;
+
+// --steadyState: a replicate is stopped once, after the last scheduled change of the scenario, the received packets
+// of the last steadyWindow seconds differ by at most steadyTolerance from the window before, for both probes;
+// windows with fewer than steadyMinPackets packets (no coverage, congested link) are never steady
+bool steadyState = false;
+double steadyWindow = 5.0;
+double steadyTolerance = 0.05;
+uint64_t steadyMinPackets = 20;
+double replicateStopTime; // when the replicate simulated by this worker ended
+
+// finished replicates are stored here and reused by later invocations; empty disables the cache
+std::string cacheDir;
+
+// storeDir gets the raw measurements of every replicate in a columnar file; aggregateDir builds the graphs
+// from such files instead of simulating
+std::string storeDir;
+std::string aggregateDir;
+
+// topology; the robots are the nodes right after the server and the APs
+uint32_t nAps = 20;
+uint32_t apGridWidth = 5;
+double apSpacing = 20.0;
+double serverX = 200.0;
+double serverY = 50.0;
+double csmaDelayMs = 2.0;
+double wifiRange = 15.0;
+std::string wifiChannel = "yans"; // yans: every frame reaches every phy, grid: spatially indexed GridSpectrumChannel, disc: no 802.11 at all
+std::string discRate = "54Mbps"; // link rate and delay of the disc links
+double discDelay = 0.0; // us, added to the propagation delay
+bool calibrate = false; // simulate every configuration with the full wifi model and with disc and compare them
+
+// event scheduler of the simulator; schedulerBench runs an AP count x routing x robot count matrix with each of them
+std::string scheduler = "map";
+bool schedulerBench = false;
+std::string benchApList = "20,100,500";
+std::string benchRobotList = "1,10";
+// csma: the server and all APs share one LAN, p2p: a point-to-point link from the server to every AP
+std::string backbone = "csma";
+
+uint32_t nRobots = 1;
+uint32_t firstRobotNodeId = 21;
+std::vector<uint32_t> robotCounts; // x axis of graphs 10 and 11
+
+// CSMA data rates of graph 9 (kbit/s), sorted; starts as a coarse log spaced sweep. With sweepBudget > 0
+// rates are added where the curve changes by more than sweepThreshold of its range, or is that uncertain,
+// until sweepBudget simulations of graph 9 are used.
+std::vector<uint64_t> sweepRates;
+uint64_t sweepBudget = 0;
+double sweepThreshold = 0.1;
+
+// area the robots may roam in before they are sent home, and the home zone
+double fenceMinX = 0.0;
+double fenceMinY = 0.0;
+double fenceMaxX = 100.0;
+double fenceMaxY = 80.0;
+double homeX = 50.0;
+double homeY = 50.0;
+double homeTolerance = 0.5;
+
+// robot speed and ping rate schedule
+double robotSpeed = 20.0;
+double robotFastSpeed = 40.0;
+double speedChangeTime = 5.0;
+double pingOffTime = 0.5;
+double pingChangeTime = 15.0;
+
+// Timed changes of all robots as time:attribute=value separated by commas; the attributes are speed (m/s),
+// onTime and offTime (s) of the OnOff applications and their dataRate. Empty for the two changes above.
+std::string eventList;
+struct TimedEvent {
+    double time;
+    std::string attribute;
+    std::string value;
+};
+std::vector<TimedEvent> timedEvents;
+
+// what is simulated, graphs with equal configurations share their simulations
+struct SimulationConfig {
+    bool olsrRouting;
+    uint64_t dataRatekb;
+    uint32_t nRobots;
+};
+
+// Configurations of the graphs as routing:csma rate in kbit/s. Graphs 1-4 (received packets) and 5-8 (goodput)
+// show the four time series, graph 9 sweeps the rate with sweepRouting, graphs 10-12 sweep the robot count.
+std::string timeSeriesList = "olsr:5000,olsr:5,aodv:5000,aodv:5";
+std::string sweepRouting = "aodv";
+std::string robotSweepConfig = "olsr:5000";
+std::vector<SimulationConfig> timeSeries;
+SimulationConfig robotSweep;
+
+// one replicate of one configuration
+struct SimulationTask {
+    SimulationConfig config;
+    uint64_t replicate;
+};
+
+// --bench: wall time, CPU time and peak RSS of every phase, written to benchFile as JSON
+bool doBench = false;
+std::string benchFile = "bench.json";
+
+enum BenchPhase { PHASE_TOPOLOGY, PHASE_STACK, PHASE_RUN, N_WORKER_PHASES };
+const char *benchPhaseNames[N_WORKER_PHASES] = {"topology", "stack", "run"};
+
+struct PhaseMeasurement {
+    double wallSeconds;
+    double cpuSeconds;
+    int64_t peakRssKb;
+    uint64_t events; // only for the run phase
+};
+
+static double wallClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static double cpuClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static int64_t peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+}
+
+// Adds the time between Start() and Stop() to a phase, a phase may consist of several intervals
+class PhaseTimer {
+public:
+    void Start() {
+        m_wall = wallClock();
+        m_cpu = cpuClock();
+    }
+
+    void Stop(PhaseMeasurement &phase) {
+        phase.wallSeconds += wallClock() - m_wall;
+        phase.cpuSeconds += cpuClock() - m_cpu;
+        phase.peakRssKb = std::max(phase.peakRssKb, peakRssKb());
+    }
+
+private:
+    double m_wall;
+    double m_cpu;
+};
+
+// phases of the replicate simulated by this worker
+std::vector<PhaseMeasurement> benchPhases;
+
+// a change of the next hop of a robot's own packets; changes while the route is still being repaired
+// are merged into the pending event
+struct HandoverEvent {
+    double time; // first frame to the new next hop (s)
+    uint32_t robot;
+    uint32_t changes;
+    double outage; // from the last delivery before the change to the first delivery of a packet sent after it (s)
+    double firstDelivery; // from the change to that delivery (s), negative when nothing arrived before the end
+    uint64_t controlFrames; // routing frames sent on wifi by all nodes during the outage
+};
+
+// what a worker process sends back to the parent after its replicate
+struct ReplicateResult {
+    std::vector<int> packetsPerBin;
+    std::vector<int> allPacketsPerBin;
+    uint64_t packetsTotal;
+    uint64_t allPacketsTotal;
+    std::vector<uint64_t> robotPacketsSent;
+    std::vector<uint64_t> robotPacketsReceived;
+    std::vector<double> arrivalTimes;
+    std::vector<double> allPacketsArrivalTimes;
+    std::vector<PhaseMeasurement> phases;
+    std::vector<uint64_t> delayBuckets;
+    std::vector<uint64_t> jitterBuckets;
+    uint64_t packetsReordered;
+    std::vector<uint64_t> overheadNodeFrames;
+    std::vector<uint64_t> overheadNodeBytes;
+    std::vector<uint64_t> overheadBinFrames;
+    std::vector<uint64_t> overheadBinBytes;
+    std::vector<HandoverEvent> handovers;
+    double stopTime; // less than endTime when stopped in steady state; the bins end there
+    double endTime;
+    bool fromCache;
+};
+
+// Packet counts per time bin, updated directly from the trace callbacks.
+// Memory only depends on the number of bins, not on the number of packets.
+struct PacketHistogram {
+    double binWidth;
+    std::vector<int> bins;
+    uint64_t total;
+
+    void Reset(double width, double duration) {
+        binWidth = width;
+        bins.assign((size_t) ceil(duration / width), 0);
+        total = 0;
+    }
+
+    void Add(double time) {
+        ++total;
+        size_t bin = (size_t) (time / binWidth);
+        if (bin < bins.size())
+            bins[bin]++;
+    }
+};
+
+// Mean and sample variance updated one replicate at a time (Welford's algorithm)
+struct RunningStats {
+    uint64_t count;
+    double mean;
+    double m2; // sum of squared differences from the mean
+
+    RunningStats() : count(0), mean(0.0), m2(0.0) {}
+
+    void Add(double value) {
+        ++count;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    double StdDev() const {
+        return count > 1 ? sqrt(m2 / (count - 1)) : 0.0;
+    }
+
+    // half width of the 95% confidence interval of the mean
+    double HalfWidth() const {
+        if (count < 2)
+            return INFINITY;
+        static const double t975[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        uint64_t df = count - 1;
+        double t = df <= 30 ? t975[df - 1] : 1.96 + 2.37 / df; // Cornish-Fisher beyond the table
+        return t * StdDev() / sqrt((double) count);
+    }
+};
+
+// Log bucketed histogram (as in HdrHistogram) of non-negative integers: exact below 64, above that 32 buckets
+// per power of two, so every value is kept within 3% in a fixed 15 kB whatever the number of samples
+struct LogHistogram {
+    static const int SUB_BUCKETS = 32;
+    std::vector<uint64_t> buckets;
+    uint64_t count;
+
+    void Reset() {
+        buckets.assign(60 * SUB_BUCKETS, 0);
+        count = 0;
+    }
+
+    static size_t Index(uint64_t value) {
+        if (value < 2 * SUB_BUCKETS)
+            return value;
+        int shift = 63 - __builtin_clzll(value) - 5;
+        return shift * SUB_BUCKETS + (value >> shift);
+    }
+
+    // middle of the values falling into bucket index
+    static double Value(size_t index) {
+        size_t shift = index < 2 * SUB_BUCKETS ? 0 : index / SUB_BUCKETS - 1;
+        uint64_t lowest = (uint64_t) (index - shift * SUB_BUCKETS) << shift;
+        return lowest + (((uint64_t) 1 << shift) - 1) / 2.0;
+    }
+
+    void Add(uint64_t value) {
+        ++buckets[Index(value)];
+        ++count;
+    }
+
+    void Merge(const std::vector<uint64_t> &other) {
+        if (buckets.size() < other.size())
+            buckets.resize(other.size(), 0);
+        for (size_t i = 0; i < other.size(); ++i) {
+            buckets[i] += other[i];
+            count += other[i];
+        }
+    }
+
+    double Percentile(double fraction) const {
+        if (count == 0)
+            return 0.0;
+        uint64_t rank = std::max((uint64_t) 1, (uint64_t) ceil(fraction * count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= rank)
+                return Value(i);
+        }
+        return Value(buckets.size() - 1);
+    }
+
+    // the buckets up to the last used one, that is all a worker has to send
+    std::vector<uint64_t> Used() const {
+        size_t used = buckets.size();
+        while (used > 0 && buckets[used - 1] == 0)
+            --used;
+        return std::vector<uint64_t>(buckets.begin(), buckets.begin() + used);
+    }
+};
+
+const double latencyPercentiles[3] = {0.5, 0.99, 0.999};
 
 // Application packets meassurments
 int packetsReceived = 0;
+PacketHistogram packetsHistogram;
 std::vector<double> arrivalTimes = {};
-std::vector<int> packetsPerSec[10];
 
 // all packets meassurements
 int allPacketsRecieved = 0;
+PacketHistogram allPacketsHistogram;
 std::vector<double> allPacketsArrivalTimes = {};
-std::vector<int> allPacketsMeassurements[10];
 
-// graph 9
-std::vector<double> bitRates = {};
+// one-way delay of the application packets and its variation between consecutive packets of a robot (us)
+LogHistogram delayHistogram;
+LogHistogram jitterHistogram;
+uint64_t packetsReordered = 0; // arrived after a packet the robot sent later
+
+// --overhead: frames and bytes every node transmits on wifi and CSMA, by class, in total and per time bin
+bool doOverhead = false;
+
+enum PacketClass { CLASS_DATA, CLASS_ROUTING, CLASS_ARP, CLASS_MANAGEMENT, CLASS_OTHER, N_CLASSES };
+const char *packetClassNames[N_CLASSES] = {"data", "routing", "arp", "management", "other"};
+
+// management also covers the 802.11 control frames (ACK, RTS, CTS)
+struct OverheadCounters {
+    double binWidth;
+    std::vector<uint64_t> nodeFrames; // node * N_CLASSES + class
+    std::vector<uint64_t> nodeBytes;
+    std::vector<uint64_t> binFrames; // bin * N_CLASSES + class
+    std::vector<uint64_t> binBytes;
+
+    void Reset(uint32_t nodes, double width, double duration) {
+        binWidth = width;
+        nodeFrames.assign(nodes * N_CLASSES, 0);
+        nodeBytes.assign(nodes * N_CLASSES, 0);
+        binFrames.assign((size_t) ceil(duration / width) * N_CLASSES, 0);
+        binBytes.assign(binFrames.size(), 0);
+    }
 
-// position allocators accessible from callbacks
-bool returningHome = false;
-Ptr<RandomRectanglePositionAllocator> waypointAllocator;
-Ptr<RandomRectanglePositionAllocator> homeAllocator;
+    void Add(uint32_t node, int packetClass, uint32_t bytes, double time) {
+        size_t index = node * N_CLASSES + packetClass;
+        if (index < nodeFrames.size()) {
+            nodeFrames[index]++;
+            nodeBytes[index] += bytes;
+        }
+        index = (size_t) (time / binWidth) * N_CLASSES + packetClass;
+        if (index < binFrames.size()) {
+            binFrames[index]++;
+            binBytes[index] += bytes;
+        }
+    }
+};
+OverheadCounters overhead;
+
+// --handover: every change of the next hop a robot sends its own packets to, and how the route recovered
+bool doHandover = false;
+std::vector<HandoverEvent> handovers;
+uint64_t routingFramesSent = 0;
+
+// Added to every application packet by its robot, so the server can tell how long it was on its way
+class LatencyTag : public Tag {
+public:
+    static TypeId GetTypeId();
+    virtual TypeId GetInstanceTypeId() const;
+    LatencyTag();
+    LatencyTag(uint32_t seq, Time sent);
+
+    virtual uint32_t GetSerializedSize() const;
+    virtual void Serialize(TagBuffer buffer) const;
+    virtual void Deserialize(TagBuffer buffer);
+    virtual void Print(std::ostream &os) const;
+
+    uint32_t GetSeq() const { return m_seq; }
+    Time GetSent() const { return NanoSeconds(m_sent); }
+
+private:
+    uint32_t m_seq;
+    int64_t m_sent; // ns
+};
+
+NS_OBJECT_ENSURE_REGISTERED(LatencyTag);
+
+TypeId LatencyTag::GetTypeId() {
+    static TypeId tid = TypeId("LatencyTag")
+        .SetParent<Tag>()
+        .AddConstructor<LatencyTag>();
+    return tid;
+}
 
-void packetReceivedCallback(Ptr< const Packet > packet, const Address &address) {
-    packetsReceived++;
-    arrivalTimes.push_back(Simulator::Now().GetSeconds());
+TypeId LatencyTag::GetInstanceTypeId() const {
+    return GetTypeId();
+}
+
+LatencyTag::LatencyTag() : m_seq(0), m_sent(0) {
+}
+
+LatencyTag::LatencyTag(uint32_t seq, Time sent) : m_seq(seq), m_sent(sent.GetNanoSeconds()) {
+}
+
+uint32_t LatencyTag::GetSerializedSize() const {
+    return sizeof(uint32_t) + sizeof(uint64_t);
+}
+
+void LatencyTag::Serialize(TagBuffer buffer) const {
+    buffer.WriteU32(m_seq);
+    buffer.WriteU64(m_sent);
+}
+
+void LatencyTag::Deserialize(TagBuffer buffer) {
+    m_seq = buffer.ReadU32();
+    m_sent = buffer.ReadU64();
+}
+
+void LatencyTag::Print(std::ostream &os) const {
+    os << "seq=" << m_seq << " sent=" << m_sent << "ns";
+}
+
+// state of one robot, robots[i] is node firstRobotNodeId + i
+struct Robot {
+    Ptr<MobilityModel> mobility;
+    Ptr<Application> onOff;
+    uint64_t packetsSent;
+    uint64_t packetsReceived;
+    // receive side of the latency tags
+    uint64_t packetsTagged;
+    uint32_t highestSeq;
+    int64_t lastDelay; // us
+    double lastDelivery; // s, valid once packetsTagged > 0
+    uint64_t routingAtLastDelivery;
+    // next hop of the robot's own packets and the handover waiting for its first delivery
+    Mac48Address nextHop;
+    bool hasNextHop;
+    bool handoverPending;
+    HandoverEvent handover;
+    double outageStart;
+    uint64_t routingAtOutageStart;
+};
+std::vector<Robot> robots;
+std::map<Ipv4Address, uint32_t> robotByAddress;
+
+// Uniform grid of square cells over the plane. Items standing still are filed into the cell of
+// their position, so a range query only visits the cells overlapped by the query disc. Moving
+// items are kept in a separate list that every query returns; CourseChange moves items between
+// the two, so the index is updated incrementally as nodes start and stop.
+template <typename T>
+class SpatialIndex {
+public:
+    SpatialIndex() : m_cellSize(1.0) {}
+
+    void SetCellSize(double size) {
+        m_cellSize = size;
+    }
+
+    void Add(T item, Ptr<MobilityModel> mobility) {
+        Entry entry = {item, mobility, false, Cell(0, 0)};
+        m_entries.push_back(entry);
+        m_byModel[PeekPointer(mobility)] = m_entries.size() - 1;
+        mobility->TraceConnectWithoutContext("CourseChange", MakeCallback(&SpatialIndex<T>::CourseChanged, this));
+        File(m_entries.size() - 1);
+    }
+
+    // Appends all items that may be within range of position; the caller checks the exact distance.
+    void Query(const Vector &position, double range, std::vector<T> &result) const {
+        int64_t minX = Coordinate(position.x - range);
+        int64_t maxX = Coordinate(position.x + range);
+        int64_t minY = Coordinate(position.y - range);
+        int64_t maxY = Coordinate(position.y + range);
+        for (int64_t x = minX; x <= maxX; ++x) {
+            for (int64_t y = minY; y <= maxY; ++y) {
+                typename std::map<Cell, std::vector<size_t> >::const_iterator cell = m_cells.find(Cell(x, y));
+                if (cell == m_cells.end())
+                    continue;
+                for (size_t i = 0; i < cell->second.size(); ++i)
+                    result.push_back(m_entries[cell->second[i]].item);
+            }
+        }
+        for (size_t i = 0; i < m_moving.size(); ++i)
+            result.push_back(m_entries[m_moving[i]].item);
+    }
+
+private:
+    typedef std::pair<int64_t, int64_t> Cell;
+
+    struct Entry {
+        T item;
+        Ptr<MobilityModel> mobility;
+        bool moving;
+        Cell cell;
+    };
+
+    int64_t Coordinate(double value) const {
+        return (int64_t) floor(value / m_cellSize);
+    }
+
+    void File(size_t index) {
+        Entry &entry = m_entries[index];
+        Vector velocity = entry.mobility->GetVelocity();
+        entry.moving = velocity.x != 0.0 || velocity.y != 0.0 || velocity.z != 0.0;
+        if (entry.moving) {
+            m_moving.push_back(index);
+        } else {
+            Vector position = entry.mobility->GetPosition();
+            entry.cell = Cell(Coordinate(position.x), Coordinate(position.y));
+            m_cells[entry.cell].push_back(index);
+        }
+    }
+
+    void Unfile(size_t index) {
+        Entry &entry = m_entries[index];
+        std::vector<size_t> &list = entry.moving ? m_moving : m_cells[entry.cell];
+        list.erase(std::find(list.begin(), list.end(), index));
+        if (!entry.moving && list.empty())
+            m_cells.erase(entry.cell);
+    }
+
+    void CourseChanged(Ptr<const MobilityModel> model) {
+        typename std::map<const MobilityModel *, size_t>::iterator it = m_byModel.find(PeekPointer(model));
+        if (it == m_byModel.end())
+            return;
+        Unfile(it->second);
+        File(it->second);
+    }
+
+    double m_cellSize;
+    std::vector<Entry> m_entries;
+    std::map<Cell, std::vector<size_t> > m_cells;
+    std::vector<size_t> m_moving;
+    std::map<const MobilityModel *, size_t> m_byModel;
+};
+
+// Spectrum channel with the same unit-disc model as RangePropagationLossModel + ConstantSpeedPropagationDelayModel,
+// but a transmission is only delivered to phys found through the spatial index instead of to every phy on the channel.
+class GridSpectrumChannel : public SpectrumChannel {
+public:
+    static TypeId GetTypeId();
+    GridSpectrumChannel();
+
+    virtual void AddRx(Ptr<SpectrumPhy> phy);
+    virtual void StartTx(Ptr<SpectrumSignalParameters> params);
+    virtual std::size_t GetNDevices() const;
+    virtual Ptr<NetDevice> GetDevice(std::size_t i) const;
+
+private:
+    void StartRx(Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+    double m_range;
+    std::vector<Ptr<SpectrumPhy> > m_phys;
+    std::vector<Ptr<SpectrumPhy> > m_unindexed; // phys whose node has no mobility model yet
+    SpatialIndex<Ptr<SpectrumPhy> > m_index;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(GridSpectrumChannel);
+
+TypeId GridSpectrumChannel::GetTypeId() {
+    static TypeId tid = TypeId("GridSpectrumChannel")
+        .SetParent<SpectrumChannel>()
+        .AddConstructor<GridSpectrumChannel>()
+        .AddAttribute("MaxRange", "Maximum transmission range (m)",
+                DoubleValue(15.0),
+                MakeDoubleAccessor(&GridSpectrumChannel::m_range),
+                MakeDoubleChecker<double>(0.0));
+    return tid;
+}
+
+GridSpectrumChannel::GridSpectrumChannel() : m_range(15.0) {
+}
+
+void GridSpectrumChannel::AddRx(Ptr<SpectrumPhy> phy) {
+    m_phys.push_back(phy);
+    m_unindexed.push_back(phy);
+}
+
+void GridSpectrumChannel::StartTx(Ptr<SpectrumSignalParameters> txParams) {
+    // the wifi devices are installed before the mobility models, so phys are indexed at their first use
+    if (!m_unindexed.empty()) {
+        std::vector<Ptr<SpectrumPhy> > unindexed;
+        unindexed.swap(m_unindexed);
+        m_index.SetCellSize(m_range);
+        for (size_t i = 0; i < unindexed.size(); ++i) {
+            Ptr<MobilityModel> mobility = unindexed[i]->GetMobility();
+            if (mobility)
+                m_index.Add(unindexed[i], mobility);
+            else
+                m_unindexed.push_back(unindexed[i]);
+        }
+    }
+
+    Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility();
+    std::vector<Ptr<SpectrumPhy> > receivers(m_unindexed);
+    if (senderMobility)
+        m_index.Query(senderMobility->GetPosition(), m_range, receivers);
+    else
+        receivers = m_phys;
+
+    for (size_t i = 0; i < receivers.size(); ++i) {
+        if (receivers[i] == txParams->txPhy)
+            continue;
+
+        Time delay = Seconds(0);
+        Ptr<MobilityModel> receiverMobility = receivers[i]->GetMobility();
+        if (senderMobility && receiverMobility) {
+            double distance = senderMobility->GetDistanceFrom(receiverMobility);
+            if (distance > m_range)
+                continue;
+            delay = Seconds(distance / 299792458.0); // same as ConstantSpeedPropagationDelayModel
+        }
+
+        Ptr<NetDevice> device = receivers[i]->GetDevice();
+        uint32_t nodeId = device ? device->GetNode()->GetId() : 0;
+        Simulator::ScheduleWithContext(nodeId, delay, &GridSpectrumChannel::StartRx, this, txParams->Copy(), receivers[i]);
+    }
+}
+
+void GridSpectrumChannel::StartRx(Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver) {
+    receiver->StartRx(params);
+}
+
+std::size_t GridSpectrumChannel::GetNDevices() const {
+    return m_phys.size();
+}
+
+Ptr<NetDevice> GridSpectrumChannel::GetDevice(std::size_t i) const {
+    return m_phys[i]->GetDevice();
+}
+
+// Reduced fidelity replacement of the whole 802.11 stack for quick sweeps: a frame reaches every device within
+// MaxRange after the channel's Delay plus the propagation delay, without PHY, MAC, collisions or retries.
+// Devices are found through the same spatial index as in GridSpectrumChannel.
+class DiscSimpleChannel : public SimpleChannel {
+public:
+    static TypeId GetTypeId();
+    DiscSimpleChannel();
+
+    virtual void Add(Ptr<SimpleNetDevice> device);
+    virtual void Send(Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from, Ptr<SimpleNetDevice> sender);
+
+private:
+    double m_range;
+    bool m_started; // m_delay is read from the Delay attribute at the first frame
+    Time m_delay;
+    std::vector<Ptr<SimpleNetDevice> > m_unindexed; // devices whose node has no mobility model yet
+    SpatialIndex<Ptr<SimpleNetDevice> > m_index;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(DiscSimpleChannel);
+
+TypeId DiscSimpleChannel::GetTypeId() {
+    static TypeId tid = TypeId("DiscSimpleChannel")
+        .SetParent<SimpleChannel>()
+        .AddConstructor<DiscSimpleChannel>()
+        .AddAttribute("MaxRange", "Maximum transmission range (m)",
+                DoubleValue(15.0),
+                MakeDoubleAccessor(&DiscSimpleChannel::m_range),
+                MakeDoubleChecker<double>(0.0));
+    return tid;
+}
+
+DiscSimpleChannel::DiscSimpleChannel() : m_range(15.0), m_started(false) {
+}
+
+void DiscSimpleChannel::Add(Ptr<SimpleNetDevice> device) {
+    SimpleChannel::Add(device);
+    m_unindexed.push_back(device);
+}
+
+void DiscSimpleChannel::Send(Ptr<Packet> p, uint16_t protocol, Mac48Address to, Mac48Address from, Ptr<SimpleNetDevice> sender) {
+    if (!m_started) {
+        TimeValue delay;
+        GetAttribute("Delay", delay);
+        m_delay = delay.Get();
+        m_started = true;
+    }
+
+    // the devices are installed before the mobility models, so they are indexed at their first use
+    if (!m_unindexed.empty()) {
+        std::vector<Ptr<SimpleNetDevice> > unindexed;
+        unindexed.swap(m_unindexed);
+        m_index.SetCellSize(m_range);
+        for (size_t i = 0; i < unindexed.size(); ++i) {
+            Ptr<MobilityModel> mobility = unindexed[i]->GetNode()->GetObject<MobilityModel>();
+            if (mobility)
+                m_index.Add(unindexed[i], mobility);
+            else
+                m_unindexed.push_back(unindexed[i]);
+        }
+    }
+
+    Ptr<MobilityModel> senderMobility = sender->GetNode()->GetObject<MobilityModel>();
+    std::vector<Ptr<SimpleNetDevice> > receivers(m_unindexed);
+    if (senderMobility) {
+        m_index.Query(senderMobility->GetPosition(), m_range, receivers);
+    } else {
+        for (std::size_t i = 0; i < GetNDevices(); ++i)
+            receivers.push_back(DynamicCast<SimpleNetDevice>(GetDevice(i)));
+    }
+
+    for (size_t i = 0; i < receivers.size(); ++i) {
+        if (receivers[i] == sender)
+            continue;
+
+        Time delay = m_delay;
+        Ptr<MobilityModel> receiverMobility = receivers[i]->GetNode()->GetObject<MobilityModel>();
+        if (senderMobility && receiverMobility) {
+            double distance = senderMobility->GetDistanceFrom(receiverMobility);
+            if (distance > m_range)
+                continue;
+            delay += Seconds(distance / 299792458.0);
+        }
+        Simulator::ScheduleWithContext(receivers[i]->GetNode()->GetId(), delay, &SimpleNetDevice::Receive, receivers[i], p->Copy(), protocol, to, from);
+    }
+}
+
+// Position allocator for RandomWaypointMobilityModel that hands out roaming waypoints, or the home
+// position while its robot is returning home. Switching is a flag, no attribute has to be set.
+class ReturnHomePositionAllocator : public PositionAllocator {
+public:
+    static TypeId GetTypeId();
+    ReturnHomePositionAllocator();
+
+    void SetWaypoints(Ptr<PositionAllocator> waypoints);
+    void SetHome(Ptr<PositionAllocator> home);
+    void SetReturningHome(bool returningHome);
+    bool IsReturningHome() const;
+
+    virtual Vector GetNext() const;
+    virtual int64_t AssignStreams(int64_t stream);
+
+private:
+    Ptr<PositionAllocator> m_waypoints;
+    Ptr<PositionAllocator> m_home;
+    bool m_returningHome;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ReturnHomePositionAllocator);
+
+TypeId ReturnHomePositionAllocator::GetTypeId() {
+    static TypeId tid = TypeId("ReturnHomePositionAllocator")
+        .SetParent<PositionAllocator>()
+        .AddConstructor<ReturnHomePositionAllocator>();
+    return tid;
+}
+
+ReturnHomePositionAllocator::ReturnHomePositionAllocator() : m_returningHome(false) {
+}
+
+void ReturnHomePositionAllocator::SetWaypoints(Ptr<PositionAllocator> waypoints) {
+    m_waypoints = waypoints;
+}
+
+void ReturnHomePositionAllocator::SetHome(Ptr<PositionAllocator> home) {
+    m_home = home;
+}
+
+void ReturnHomePositionAllocator::SetReturningHome(bool returningHome) {
+    m_returningHome = returningHome;
+}
+
+bool ReturnHomePositionAllocator::IsReturningHome() const {
+    return m_returningHome;
 }
 
-void returnHomeCallback(Ptr< const MobilityModel> mobModel) {
-    Vector pos = mobModel->GetPosition();
+Vector ReturnHomePositionAllocator::GetNext() const {
+    return m_returningHome ? m_home->GetNext() : m_waypoints->GetNext();
+}
+
+int64_t ReturnHomePositionAllocator::AssignStreams(int64_t stream) {
+    int64_t used = m_waypoints->AssignStreams(stream);
+    return used + m_home->AssignStreams(stream + used);
+}
+
+// Sends robots home once they leave the fenced area and lets them roam again when they are back.
+// Every robot's CourseChange is connected directly to its mobility model with the robot index bound
+// into the callback, so the hot path does no Config path resolution and no lookups at all.
+class GeofenceController {
+public:
+    GeofenceController();
+
+    void SetBounds(double minX, double minY, double maxX, double maxY);
+    // a robot is home when it is closer than tolerance to home on both axes
+    void SetHome(const Vector &home, double tolerance);
+
+    void Add(Ptr<MobilityModel> model, Ptr<ReturnHomePositionAllocator> allocator);
+    void Clear();
+
+private:
+    static void CourseChanged(GeofenceController *controller, uint32_t robot, Ptr<const MobilityModel> model);
+
+    double m_minX;
+    double m_minY;
+    double m_maxX;
+    double m_maxY;
+    Vector m_home;
+    double m_tolerance;
+    std::vector<Ptr<ReturnHomePositionAllocator> > m_allocators;
+};
+
+GeofenceController::GeofenceController()
+    : m_minX(0.0), m_minY(0.0), m_maxX(100.0), m_maxY(80.0), m_home(50.0, 50.0, 0.0), m_tolerance(0.5) {
+}
+
+void GeofenceController::SetBounds(double minX, double minY, double maxX, double maxY) {
+    m_minX = minX;
+    m_minY = minY;
+    m_maxX = maxX;
+    m_maxY = maxY;
+}
+
+void GeofenceController::SetHome(const Vector &home, double tolerance) {
+    m_home = home;
+    m_tolerance = tolerance;
+}
+
+void GeofenceController::Add(Ptr<MobilityModel> model, Ptr<ReturnHomePositionAllocator> allocator) {
+    uint32_t robot = m_allocators.size();
+    m_allocators.push_back(allocator);
+    model->TraceConnectWithoutContext("CourseChange", MakeBoundCallback(&GeofenceController::CourseChanged, this, robot));
+}
+
+void GeofenceController::Clear() {
+    m_allocators.clear();
+}
+
+void GeofenceController::CourseChanged(GeofenceController *controller, uint32_t robot, Ptr<const MobilityModel> model) {
+    Ptr<ReturnHomePositionAllocator> allocator = controller->m_allocators[robot];
+    Vector pos = model->GetPosition();
 
     if (logRobotCallback)
-        std::cout << "[" << Simulator::Now().GetSeconds() << "s] " << pos.x << "; " << pos.y << std::endl;
+        std::cout << "[" << Simulator::Now().GetSeconds() << "s] robot " << robot << ": " << pos.x << "; " << pos.y << std::endl;
 
-    if (!returningHome) {
+    if (!allocator->IsReturningHome()) {
         // is the robot out of bounds?
-        if (pos.x < 0.0 || pos.x > 100.0 || pos.y < 0.0 || pos.y > 80.0) {
-            returningHome = true;
-            Config::Set("/NodeList/21/$ns3::MobilityModel/$ns3::RandomWaypointMobilityModel/PositionAllocator", PointerValue(homeAllocator));
+        if (pos.x < controller->m_minX || pos.x > controller->m_maxX || pos.y < controller->m_minY || pos.y > controller->m_maxY) {
+            allocator->SetReturningHome(true);
 
             if (logRobotCallback)
-                std::cout << "[" << Simulator::Now().GetSeconds() << "s] " << "robot has left AP reach and will return home." << std::endl;
+                std::cout << "[" << Simulator::Now().GetSeconds() << "s] " << "robot " << robot << " has left AP reach and will return home." << std::endl;
         }
     } else {
         // has the robot returned home?
-        if (pos.x > 49.5 && pos.x < 50.5 && pos.y > 49.5 && pos.y < 50.5) {
-            returningHome = false;
-            Config::Set("/NodeList/21/$ns3::MobilityModel/$ns3::RandomWaypointMobilityModel/PositionAllocator", PointerValue(waypointAllocator));
+        if (fabs(pos.x - controller->m_home.x) < controller->m_tolerance && fabs(pos.y - controller->m_home.y) < controller->m_tolerance) {
+            allocator->SetReturningHome(false);
 
             if (logRobotCallback)
-                std::cout << "[" << Simulator::Now().GetSeconds() << "s] " << "robot has returned home and will begin roaming again." << std::endl;
+                std::cout << "[" << Simulator::Now().GetSeconds() << "s] " << "robot " << robot << " has returned home and will begin roaming again." << std::endl;
+        }
+    }
+}
+
+GeofenceController geofence;
+
+// trace contexts look like /NodeList/<id>/...
+static uint32_t contextNodeId(const std::string &context) {
+    return (uint32_t) atoi(context.c_str() + strlen("/NodeList/"));
+}
+
+static std::string robotPath(uint32_t robot) {
+    return "/NodeList/" + std::to_string(firstRobotNodeId + robot);
+}
+
+void packetReceivedCallback(Ptr< const Packet > packet, const Address &address) {
+    packetsReceived++;
+    packetsHistogram.Add(Simulator::Now().GetSeconds());
+    if (keepArrivalTimes)
+        arrivalTimes.push_back(Simulator::Now().GetSeconds());
+
+    if (InetSocketAddress::IsMatchingType(address)) {
+        std::map<Ipv4Address, uint32_t>::iterator sender = robotByAddress.find(InetSocketAddress::ConvertFrom(address).GetIpv4());
+        if (sender != robotByAddress.end()) {
+            Robot &robot = robots[sender->second];
+            robot.packetsReceived++;
+
+            LatencyTag tag;
+            if (packet->FindFirstMatchingByteTag(tag)) {
+                int64_t delay = (Simulator::Now() - tag.GetSent()).GetMicroSeconds();
+                delayHistogram.Add(delay);
+                if (robot.packetsTagged > 0) {
+                    jitterHistogram.Add(std::abs(delay - robot.lastDelay));
+                    if (tag.GetSeq() < robot.highestSeq)
+                        ++packetsReordered;
+                }
+                if (robot.packetsTagged == 0 || tag.GetSeq() > robot.highestSeq)
+                    robot.highestSeq = tag.GetSeq();
+                robot.lastDelay = delay;
+                robot.packetsTagged++;
+
+                // the first packet sent after the change that gets through ends the outage
+                double now = Simulator::Now().GetSeconds();
+                if (robot.handoverPending && tag.GetSent().GetSeconds() >= robot.handover.time) {
+                    robot.handover.outage = now - robot.outageStart;
+                    robot.handover.firstDelivery = now - robot.handover.time;
+                    robot.handover.controlFrames = routingFramesSent - robot.routingAtOutageStart;
+                    handovers.push_back(robot.handover);
+                    robot.handoverPending = false;
+                }
+                robot.lastDelivery = now;
+                robot.routingAtLastDelivery = routingFramesSent;
+            }
         }
     }
 }
 
+void packetSentCallback(std::string context, Ptr< const Packet > packet) {
+    Robot &robot = robots[contextNodeId(context) - firstRobotNodeId];
+    packet->AddByteTag(LatencyTag(robot.packetsSent, Simulator::Now()));
+    robot.packetsSent++;
+}
+
 void macRecievePacketCallback(Ptr< const Packet> packet) {
     ++allPacketsRecieved;
-    allPacketsArrivalTimes.push_back(Simulator::Now().GetSeconds());
+    allPacketsHistogram.Add(Simulator::Now().GetSeconds());
+    if (keepArrivalTimes)
+        allPacketsArrivalTimes.push_back(Simulator::Now().GetSeconds());
+}
+
+// payload starts with the IPv4 header; OLSR and AODV control messages are UDP on their well known ports
+static int classifyIpv4(Ptr<Packet> payload) {
+    Ipv4Header ip;
+    UdpHeader udp;
+    if (payload->RemoveHeader(ip) == 0 || ip.GetProtocol() != UdpL4Protocol::PROT_NUMBER || payload->PeekHeader(udp) == 0)
+        return CLASS_OTHER;
+    uint16_t port = udp.GetDestinationPort();
+    return port == 698 || port == 654 ? CLASS_ROUTING : CLASS_DATA;
+}
+
+static int classifyEtherType(uint16_t type, Ptr<Packet> payload) {
+    if (type == ArpL3Protocol::PROT_NUMBER)
+        return CLASS_ARP;
+    if (type == Ipv4L3Protocol::PROT_NUMBER)
+        return classifyIpv4(payload);
+    return CLASS_OTHER;
+}
+
+void wifiTxCallback(std::string context, Ptr<const Packet> packet, uint16_t, WifiTxVector, MpduInfo) {
+    Ptr<Packet> copy = packet->Copy();
+    WifiMacHeader mac;
+    copy->RemoveHeader(mac);
+    int packetClass = CLASS_MANAGEMENT;
+    if (mac.IsData()) {
+        LlcSnapHeader llc;
+        copy->RemoveHeader(llc);
+        packetClass = classifyEtherType(llc.GetType(), copy);
+    }
+    overhead.Add(contextNodeId(context), packetClass, packet->GetSize(), Simulator::Now().GetSeconds());
+}
+
+// Counts the routing frames of all nodes and follows the next hop (addr1) of the frames robots send with their own packets
+void handoverTxCallback(std::string context, Ptr<const Packet> packet, uint16_t, WifiTxVector, MpduInfo) {
+    Ptr<Packet> copy = packet->Copy();
+    WifiMacHeader mac;
+    LlcSnapHeader llc;
+    Ipv4Header ip;
+    UdpHeader udp;
+    copy->RemoveHeader(mac);
+    if (!mac.IsData() || copy->RemoveHeader(llc) == 0 || llc.GetType() != Ipv4L3Protocol::PROT_NUMBER || copy->RemoveHeader(ip) == 0
+            || ip.GetProtocol() != UdpL4Protocol::PROT_NUMBER || copy->PeekHeader(udp) == 0)
+        return;
+    if (udp.GetDestinationPort() == 698 || udp.GetDestinationPort() == 654) {
+        ++routingFramesSent;
+        return;
+    }
+
+    uint32_t node = contextNodeId(context);
+    std::map<Ipv4Address, uint32_t>::iterator source = robotByAddress.find(ip.GetSource());
+    if (node < firstRobotNodeId || source == robotByAddress.end() || source->second != node - firstRobotNodeId || mac.GetAddr1().IsGroup())
+        return;
+    Robot &robot = robots[source->second];
+    if (!robot.hasNextHop) {
+        robot.nextHop = mac.GetAddr1();
+        robot.hasNextHop = true;
+        return;
+    }
+    if (mac.GetAddr1() == robot.nextHop)
+        return;
+    robot.nextHop = mac.GetAddr1();
+    if (robot.handoverPending) {
+        robot.handover.changes++;
+        return;
+    }
+
+    double now = Simulator::Now().GetSeconds();
+    robot.handoverPending = true;
+    robot.handover.time = now;
+    robot.handover.robot = source->second;
+    robot.handover.changes = 1;
+    robot.outageStart = robot.packetsTagged > 0 ? robot.lastDelivery : now;
+    robot.routingAtOutageStart = robot.packetsTagged > 0 ? robot.routingAtLastDelivery : routingFramesSent;
+}
+
+// handovers still waiting for a delivery when the simulation ends are recorded as not repaired
+static void finishHandovers(double endTime) {
+    for (size_t i = 0; i < robots.size(); ++i) {
+        Robot &robot = robots[i];
+        if (!robot.handoverPending)
+            continue;
+        robot.handover.outage = endTime - robot.outageStart;
+        robot.handover.firstDelivery = -1.0;
+        robot.handover.controlFrames = routingFramesSent - robot.routingAtOutageStart;
+        handovers.push_back(robot.handover);
+        robot.handoverPending = false;
+    }
+}
+
+void csmaTxCallback(std::string context, Ptr<const Packet> packet) {
+    Ptr<Packet> copy = packet->Copy();
+    EthernetHeader ethernet(false);
+    copy->RemoveHeader(ethernet);
+    overhead.Add(contextNodeId(context), classifyEtherType(ethernet.GetLengthType(), copy), packet->GetSize(), Simulator::Now().GetSeconds());
+}
+
+void p2pTxCallback(std::string context, Ptr<const Packet> packet) {
+    Ptr<Packet> copy = packet->Copy();
+    PppHeader ppp;
+    copy->RemoveHeader(ppp);
+    int packetClass = ppp.GetProtocol() == 0x0021 ? classifyIpv4(copy) : CLASS_OTHER; // 0x0021: IPv4 in PPP
+    overhead.Add(contextNodeId(context), packetClass, packet->GetSize(), Simulator::Now().GetSeconds());
+}
+
+static std::string constantVariable(double value) {
+    std::ostringstream variable;
+    variable << "ns3::ConstantRandomVariable[Constant=" << value << "]";
+    return variable.str();
+}
+
+static void applyEvent(size_t e) {
+    const TimedEvent &event = timedEvents[e];
+    for (uint32_t i = 0; i < robots.size(); ++i) {
+        if (event.attribute == "speed")
+            robots[i].mobility->SetAttribute("Speed", StringValue(constantVariable(atof(event.value.c_str()))));
+        else if (event.attribute == "onTime")
+            robots[i].onOff->SetAttribute("OnTime", StringValue(constantVariable(atof(event.value.c_str()))));
+        else if (event.attribute == "offTime")
+            robots[i].onOff->SetAttribute("OffTime", StringValue(constantVariable(atof(event.value.c_str()))));
+        else
+            robots[i].onOff->SetAttribute("DataRate", StringValue(event.value));
+    }
+}
+
+// Stops the replicate once both probes have settled, otherwise checks again at the end of the next bin
+static void steadyStateMonitor(double simulationTime) {
+    size_t done = (size_t) (Simulator::Now().GetSeconds() / binWidth + 1e-9);
+    size_t width = std::max((size_t) 1, (size_t) llround(steadyWindow / binWidth));
+    if (windowsAgree(packetsHistogram.bins, done, width) && windowsAgree(allPacketsHistogram.bins, done, width)) {
+        replicateStopTime = Simulator::Now().GetSeconds();
+        Simulator::Stop();
+        return;
+    }
+    if (Simulator::Now().GetSeconds() + binWidth < simulationTime)
+        Simulator::Schedule(Seconds(binWidth), &steadyStateMonitor, simulationTime);
+}
+
+// the sums of the two windows of width bins before end are both at least steadyMinPackets and differ by at most
+// steadyTolerance of the larger one
+static bool windowsAgree(const std::vector<int> &bins, size_t end, size_t width) {
+    if (end < 2 * width || end > bins.size())
+        return false;
+    double previous = 0.0, last = 0.0;
+    for (size_t i = end - 2 * width; i < end - width; ++i)
+        previous += bins[i];
+    for (size_t i = end - width; i < end; ++i)
+        last += bins[i];
+    if (std::min(last, previous) < steadyMinPackets)
+        return false;
+    return fabs(last - previous) <= steadyTolerance * std::max(last, previous);
+}
+
+// Stops the animation once its file is larger than animMaxMb. The file can only overshoot by what the writer
+// still buffers plus the frames or mobility updates since the last check.
+static void checkAnimSize() {
+    animFramesSinceCheck = 0;
+    struct stat info;
+    if (animLimited != NULL && stat(animFile.c_str(), &info) == 0 && info.st_size > animMaxMb * 1024 * 1024) {
+        animLimited->SetStopTime(Simulator::Now());
+        animLimited = NULL;
+        std::cerr << animFile << " reached " << animMaxMb << " MB, animation stopped at " << Simulator::Now().GetSeconds() << " s" << std::endl;
+    }
 }
 
-static void changeRobotSpeed() {
-    Config::Set("NodeList/21/$ns3::MobilityModel/$ns3::RandomWaypointMobilityModel/Speed", StringValue("ns3::ConstantRandomVariable[Constant=40]"));
+// checked with every mobility update written
+static void animSizeWatchdog(double stopTime) {
+    checkAnimSize();
+    if (animLimited != NULL && Simulator::Now().GetSeconds() + animMobilityInterval < stopTime)
+        Simulator::Schedule(Seconds(animMobilityInterval), &animSizeWatchdog, stopTime);
 }
 
-static void changePingFrequency() {
-    Config::Set("NodeList/21/ApplicationList/0/$ns3::OnOffApplication/OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0.5]"));
+// and every animCheckFrames frames sent, which is what the packet animation writes
+void animWifiTxCallback(Ptr<const Packet>, uint16_t, WifiTxVector, MpduInfo) {
+    if (animLimited != NULL && ++animFramesSinceCheck >= animCheckFrames)
+        checkAnimSize();
 }
 
-static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulationTime) {
+void animTxCallback(Ptr<const Packet>) {
+    if (animLimited != NULL && ++animFramesSinceCheck >= animCheckFrames)
+        checkAnimSize();
+}
+
+// a /24 is kept whenever the nodes fit into it, larger topologies get a /16
+static const char *netmaskFor(uint32_t nodes) {
+    return nodes < 254 ? "255.255.255.0" : "255.255.0.0";
+}
+
+// Builds the simulation and runs it; with prefixOnly it is only run until the applications start and left
+// for runSim() to finish
+static void doSimulation(const SimulationConfig &config, double simulationTime, bool prefixOnly = false) {
+    // everything up to Simulator::Run() is topology, except installing the internet stack and routing
+    PhaseTimer topologyTimer, stackTimer;
+    topologyTimer.Start();
+
     // Server Node
     NodeContainer serverNodes;
     serverNodes.Create(1);
@@ -105,12 +1287,14 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
 
     // AP Nodes
     NodeContainer apNodes;
-    apNodes.Create(20);
+    apNodes.Create(nAps);
 
-    // UAV Node
+    // UAV Nodes
     NodeContainer robotNodes;
-    robotNodes.Create(1);
-    Ptr<Node> robot = robotNodes.Get(0);
+    robotNodes.Create(config.nRobots);
+    firstRobotNodeId = robotNodes.Get(0)->GetId();
+    robots.assign(config.nRobots, Robot());
+    robotByAddress.clear();
 
     // helper containers to install nodes more easily
     NodeContainer ethernetNodes;
@@ -119,7 +1303,7 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
 
     NodeContainer wifiNodes;
     wifiNodes.Add(apNodes);
-    wifiNodes.Add(robot);
+    wifiNodes.Add(robotNodes);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -132,39 +1316,62 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
     mac.SetType("ns3::AdhocWifiMac");
     wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
             "DataMode", StringValue("OfdmRate54Mbps"));
-    YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default();
-    YansWifiChannelHelper wifiChannel;
-    wifiChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
-    wifiChannel.AddPropagationLoss("ns3::RangePropagationLossModel",
-            "MaxRange", DoubleValue(15.0));
-    wifiPhy.SetChannel(wifiChannel.Create());
-    NetDeviceContainer wifiDevices = wifi.Install(wifiPhy, mac, wifiNodes);
+    NetDeviceContainer wifiDevices;
+    if (wifiChannel == "grid") {
+        // only phys within range are looked at, so the cost per frame does not grow with the AP count
+        SpectrumWifiPhyHelper wifiPhy = SpectrumWifiPhyHelper::Default();
+        Ptr<GridSpectrumChannel> channel = CreateObject<GridSpectrumChannel>();
+        channel->SetAttribute("MaxRange", DoubleValue(wifiRange));
+        wifiPhy.SetChannel(channel);
+        wifiDevices = wifi.Install(wifiPhy, mac, wifiNodes);
+    } else if (wifiChannel == "disc") {
+        // abstract links for quick sweeps, see --calibrate
+        SimpleNetDeviceHelper simple;
+        simple.SetChannel("DiscSimpleChannel", "MaxRange", DoubleValue(wifiRange));
+        simple.SetChannelAttribute("Delay", TimeValue(MicroSeconds(discDelay)));
+        simple.SetDeviceAttribute("DataRate", DataRateValue(DataRate(discRate)));
+        wifiDevices = simple.Install(wifiNodes);
+    } else {
+        YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default();
+        YansWifiChannelHelper wifiChannel;
+        wifiChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+        wifiChannel.AddPropagationLoss("ns3::RangePropagationLossModel",
+                "MaxRange", DoubleValue(wifiRange));
+        wifiPhy.SetChannel(wifiChannel.Create());
+        wifiDevices = wifi.Install(wifiPhy, mac, wifiNodes);
+    }
 
     // Add the IPv4 protocol stack to the nodes in our container
     InternetStackHelper internet;
-    if (olsrRouting) {
+    if (config.olsrRouting) {
         OlsrHelper olsr;
         internet.SetRoutingHelper(olsr);
     } else {
         AodvHelper aodv;
         internet.SetRoutingHelper(aodv);
     }
+    topologyTimer.Stop(benchPhases[PHASE_TOPOLOGY]);
+    stackTimer.Start();
     internet.Install(wifiNodes);
+    stackTimer.Stop(benchPhases[PHASE_STACK]);
+    topologyTimer.Start();
 
     // Assign IPv4 addresses to the device drivers (actually to the associated IPv4 interfaces) we just created.
     Ipv4AddressHelper ipAddrs;
-    ipAddrs.SetBase("192.168.0.0", "255.255.255.0");
-    ipAddrs.Assign(wifiDevices);
+    ipAddrs.SetBase("192.168.0.0", netmaskFor(wifiNodes.GetN()));
+    Ipv4InterfaceContainer wifiInterfaces = ipAddrs.Assign(wifiDevices);
+    for (uint32_t i = 0; i < config.nRobots; ++i)
+        robotByAddress[wifiInterfaces.GetAddress(apNodes.GetN() + i)] = i;
 
     // APs Mobility
     MobilityHelper apMobility;
     apMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     apMobility.SetPositionAllocator("ns3::GridPositionAllocator",
-            "MinX", DoubleValue(10.0),
-            "MinY", DoubleValue(10.0),
-            "DeltaX", DoubleValue(20.0),
-            "DeltaY", DoubleValue(20.0),
-            "GridWidth", UintegerValue(5),
+            "MinX", DoubleValue(apSpacing / 2),
+            "MinY", DoubleValue(apSpacing / 2),
+            "DeltaX", DoubleValue(apSpacing),
+            "DeltaY", DoubleValue(apSpacing),
+            "GridWidth", UintegerValue(apGridWidth),
             "LayoutType", StringValue("RowFirst"));
     apMobility.Install(apNodes);
 
@@ -172,36 +1379,53 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
     MobilityHelper serverMobility;
     serverMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     serverMobility.SetPositionAllocator("ns3::GridPositionAllocator",
-            "MinX", DoubleValue(200.0),
-            "MinY", DoubleValue(50.0));
+            "MinX", DoubleValue(serverX),
+            "MinY", DoubleValue(serverY));
     serverMobility.Install(server);
 
-    // robot Mobility
-    Ptr<UniformRandomVariable> allocatorRandVar = CreateObject<UniformRandomVariable>();
-    allocatorRandVar->SetAttribute("Min", DoubleValue(-30.0));
-    allocatorRandVar->SetAttribute("Max", DoubleValue(130.0));
+    // robot Mobility, every robot has its own allocators and starts at home
+    Ptr<GridPositionAllocator> robotStart = CreateObject<GridPositionAllocator>();
+    robotStart->SetMinX(homeX);
+    robotStart->SetMinY(homeY);
+
+    geofence.Clear();
+    geofence.SetBounds(fenceMinX, fenceMinY, fenceMaxX, fenceMaxY);
+    geofence.SetHome(Vector(homeX, homeY, 0.0), homeTolerance);
 
-    waypointAllocator = CreateObject<RandomRectanglePositionAllocator>();
-    waypointAllocator->SetX(allocatorRandVar);
-    waypointAllocator->SetY(allocatorRandVar);
+    for (uint32_t i = 0; i < config.nRobots; ++i) {
+        Ptr<UniformRandomVariable> allocatorRandVar = CreateObject<UniformRandomVariable>();
+        allocatorRandVar->SetAttribute("Min", DoubleValue(-30.0));
+        allocatorRandVar->SetAttribute("Max", DoubleValue(130.0));
 
-    Ptr<ConstantRandomVariable> homeRandVar = CreateObject<ConstantRandomVariable>();
-    homeRandVar->SetAttribute("Constant", DoubleValue(50.0));
+        Ptr<RandomRectanglePositionAllocator> waypointAllocator = CreateObject<RandomRectanglePositionAllocator>();
+        waypointAllocator->SetX(allocatorRandVar);
+        waypointAllocator->SetY(allocatorRandVar);
 
-    homeAllocator = CreateObject<RandomRectanglePositionAllocator>();
-    homeAllocator->SetX(homeRandVar);
-    homeAllocator->SetY(homeRandVar);
+        Ptr<ConstantRandomVariable> homeXRandVar = CreateObject<ConstantRandomVariable>();
+        homeXRandVar->SetAttribute("Constant", DoubleValue(homeX));
+        Ptr<ConstantRandomVariable> homeYRandVar = CreateObject<ConstantRandomVariable>();
+        homeYRandVar->SetAttribute("Constant", DoubleValue(homeY));
 
-    MobilityHelper robotMobility;
-    robotMobility.SetMobilityModel("ns3::RandomWaypointMobilityModel",
-            "Speed", StringValue("ns3::ConstantRandomVariable[Constant=20.0]"),
-            "Pause", StringValue("ns3::ConstantRandomVariable[Constant=0.0]"),
-            "PositionAllocator", PointerValue(waypointAllocator));
+        Ptr<RandomRectanglePositionAllocator> homeAllocator = CreateObject<RandomRectanglePositionAllocator>();
+        homeAllocator->SetX(homeXRandVar);
+        homeAllocator->SetY(homeYRandVar);
 
-    robotMobility.SetPositionAllocator("ns3::GridPositionAllocator",
-            "MinX", DoubleValue(50.0),
-            "MinY", DoubleValue(50.0));
-    robotMobility.Install(robot);
+        Ptr<ReturnHomePositionAllocator> allocator = CreateObject<ReturnHomePositionAllocator>();
+        allocator->SetWaypoints(waypointAllocator);
+        allocator->SetHome(homeAllocator);
+
+        MobilityHelper robotMobility;
+        robotMobility.SetMobilityModel("ns3::RandomWaypointMobilityModel",
+                "Speed", StringValue(constantVariable(robotSpeed)),
+                "Pause", StringValue("ns3::ConstantRandomVariable[Constant=0.0]"),
+                "PositionAllocator", PointerValue(allocator));
+
+        robotMobility.SetPositionAllocator(robotStart);
+        robotMobility.Install(robotNodes.Get(i));
+
+        robots[i].mobility = robotNodes.Get(i)->GetObject<MobilityModel>();
+        geofence.Add(robots[i].mobility, allocator);
+    }
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // Construct the LAN                                                     //
@@ -209,19 +1433,42 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
     ///////////////////////////////////////////////////////////////////////////
 
     // Reset the address base-- all of the CSMA networks will be in the "172.16 address space
-    ipAddrs.SetBase("172.16.0.0", "255.255.255.0");
-
-    // Create the CSMA net devices and install them into the nodes in our collection.
-    CsmaHelper csma;
-    csma.SetChannelAttribute("DataRate",
-            DataRateValue(DataRate(dataRatekb * 1000)));
-    csma.SetChannelAttribute("Delay", TimeValue(MilliSeconds(2)));
-    NetDeviceContainer lanDevices = csma.Install(ethernetNodes);
+    ipAddrs.SetBase("172.16.0.0", netmaskFor(ethernetNodes.GetN()));
+
+    NetDeviceContainer lanDevices;
+    std::vector<NetDeviceContainer> links;
+    if (backbone == "p2p") {
+        // the same rate and delay on every link, each link is a /30 of its own
+        ipAddrs.SetBase("172.16.0.0", "255.255.255.252");
+        PointToPointHelper p2p;
+        p2p.SetDeviceAttribute("DataRate", DataRateValue(DataRate(config.dataRatekb * 1000)));
+        p2p.SetChannelAttribute("Delay", TimeValue(MicroSeconds(csmaDelayMs * 1000)));
+        for (uint32_t i = 0; i < apNodes.GetN(); ++i)
+            links.push_back(p2p.Install(server, apNodes.Get(i)));
+    } else {
+        // Create the CSMA net devices and install them into the nodes in our collection.
+        CsmaHelper csma;
+        csma.SetChannelAttribute("DataRate",
+                DataRateValue(DataRate(config.dataRatekb * 1000)));
+        csma.SetChannelAttribute("Delay", TimeValue(MicroSeconds(csmaDelayMs * 1000)));
+        lanDevices = csma.Install(ethernetNodes);
+    }
 
     // Add the IPv4 protocol stack to the new LAN nodes (only the server is new!)
+    topologyTimer.Stop(benchPhases[PHASE_TOPOLOGY]);
+    stackTimer.Start();
     internet.Install(serverNodes);
+    stackTimer.Stop(benchPhases[PHASE_STACK]);
+    topologyTimer.Start();
     // Assign IPv4 addresses to the device drivers (actually to the associated IPv4 interfaces) we just created.
-    ipAddrs.Assign(lanDevices);
+    if (backbone == "p2p") {
+        for (size_t i = 0; i < links.size(); ++i) {
+            ipAddrs.Assign(links[i]);
+            ipAddrs.NewNetwork();
+        }
+    } else {
+        ipAddrs.Assign(lanDevices);
+    }
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -231,7 +1478,7 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
 
     // Create the OnOff application to send UDP datagrams of size
     // 210 bytes at a rate of 10 Kb/s, between two nodes
-    // Data is sent from the robot to the server
+    // Data is sent from every robot to the server
 
     uint16_t port = 9; // Discard port (RFC 863)
 
@@ -241,15 +1488,17 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
     OnOffHelper onoff("ns3::UdpSocketFactory",
             Address(InetSocketAddress(remoteAddr, port)));
 
-    ApplicationContainer apps = onoff.Install(robot);
-    apps.Start(Seconds(3));
+    ApplicationContainer apps = onoff.Install(robotNodes);
+    for (uint32_t i = 0; i < config.nRobots; ++i)
+        robots[i].onOff = apps.Get(i);
+    apps.Start(Seconds(appStartTime));
     apps.Stop(Seconds(simulationTime - 1));
 
     // Create a packet sink to receive these packets
     PacketSinkHelper sink("ns3::UdpSocketFactory",
             InetSocketAddress(Ipv4Address::GetAny(), port));
     apps = sink.Install(server);
-    apps.Start(Seconds(3));
+    apps.Start(Seconds(appStartTime));
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -257,14 +1506,26 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
 
-    Config::ConnectWithoutContext("/NodeList/21/$ns3::MobilityModel/CourseChange", MakeCallback(&returnHomeCallback));
-    if (makeGraph >= 1 && makeGraph <= 8)
-        Config::ConnectWithoutContext("/NodeList/0/ApplicationList/0/$ns3::PacketSink/Rx", MakeCallback(&packetReceivedCallback));
-    if (makeGraph >= 5 && makeGraph <= 9)
+    // the callback finds its robot from the node id in the trace context
+    for (uint32_t i = 0; i < config.nRobots; ++i)
+        Config::Connect(robotPath(i) + "/ApplicationList/0/$ns3::OnOffApplication/Tx", MakeCallback(&packetSentCallback));
+    // both probes are attached, so that one simulation serves every graph of its configuration
+    Config::ConnectWithoutContext("/NodeList/0/ApplicationList/0/$ns3::PacketSink/Rx", MakeCallback(&packetReceivedCallback));
+    if (backbone == "p2p")
+        Config::ConnectWithoutContext("/NodeList/0/DeviceList/*/$ns3::PointToPointNetDevice/MacRx", MakeCallback(&macRecievePacketCallback));
+    else
         Config::ConnectWithoutContext("/NodeList/0/DeviceList/0/$ns3::CsmaNetDevice/MacRx", MakeCallback(&macRecievePacketCallback));
+    if (doOverhead) {
+        overhead.Reset(NodeList::GetNNodes(), binWidth, simulationTime);
+        Config::Connect("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferTx", MakeCallback(&wifiTxCallback));
+        Config::Connect("/NodeList/*/DeviceList/*/$ns3::CsmaNetDevice/PhyTxBegin", MakeCallback(&csmaTxCallback));
+        Config::Connect("/NodeList/*/DeviceList/*/$ns3::PointToPointNetDevice/PhyTxBegin", MakeCallback(&p2pTxCallback));
+    }
+    if (doHandover)
+        Config::Connect("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferTx", MakeCallback(&handoverTxCallback));
 
-    Simulator::Schedule(Seconds(5.0), &changeRobotSpeed);
-    Simulator::Schedule(Seconds(15.0), &changePingFrequency);
+    for (size_t e = 0; e < timedEvents.size(); ++e)
+        Simulator::Schedule(Seconds(timedEvents[e].time), &applyEvent, e);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -273,7 +1534,11 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
     ///////////////////////////////////////////////////////////////////////////
 
     if (doNetanim) {
-        AnimationInterface anim("netanim.xml");
+        AnimationInterface anim(animFile);
+        double stopTime = animStop > 0.0 ? std::min(animStop, simulationTime) : simulationTime;
+        anim.SetStartTime(Seconds(animStart));
+        anim.SetStopTime(Seconds(stopTime));
+        anim.SetMobilityPollInterval(Seconds(animMobilityInterval));
 
         // APs
         for (int i = 0; i < apNodes.GetN(); ++i) {
@@ -283,21 +1548,93 @@ static void doSimulation(bool olsrRouting, uint64_t dataRatekb, double simulatio
         // server
         anim.UpdateNodeColor(serverNodes.Get(0), 0, 255, 0);
         anim.UpdateNodeDescription(serverNodes.Get(0), "Server");
-        // robot
-        anim.UpdateNodeColor(robotNodes.Get(0), 255, 0, 0);
-        anim.UpdateNodeDescription(robotNodes.Get(0), "Robot");
+        // robots
+        for (uint32_t i = 0; i < robotNodes.GetN(); ++i) {
+            anim.UpdateNodeColor(robotNodes.Get(i), 255, 0, 0);
+            anim.UpdateNodeDescription(robotNodes.Get(i), "Robot " + std::to_string(i));
+        }
 
-        anim.EnablePacketMetadata();
+        if (!animPackets)
+            anim.SkipPacketTracing();
+        else if (animMetadata)
+            anim.EnablePacketMetadata();
+        if (animMaxMb > 0.0) {
+            animLimited = &anim;
+            animFramesSinceCheck = 0;
+            Simulator::Schedule(Seconds(animStart), &animSizeWatchdog, stopTime);
+            if (animPackets) {
+                Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/MonitorSnifferTx", MakeCallback(&animWifiTxCallback));
+                Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::CsmaNetDevice/PhyTxBegin", MakeCallback(&animTxCallback));
+                Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/$ns3::PointToPointNetDevice/PhyTxBegin", MakeCallback(&animTxCallback));
+            }
+        }
 
+        topologyTimer.Stop(benchPhases[PHASE_TOPOLOGY]);
         runSim(simulationTime);
+        animLimited = NULL;
+    } else if (prefixOnly) {
+        topologyTimer.Stop(benchPhases[PHASE_TOPOLOGY]);
+        Simulator::Stop(Seconds(appStartTime));
+        Simulator::Run();
     } else {
+        topologyTimer.Stop(benchPhases[PHASE_TOPOLOGY]);
         runSim(simulationTime);
     }
 }
 
+// New random streams for everything random in the simulation, drawn from the current RNG run
+static void assignStreams(const SimulationConfig &config) {
+    NodeContainer nodes = NodeContainer::GetGlobal();
+    NetDeviceContainer wifiDevices, csmaDevices;
+    for (uint32_t n = 0; n < nodes.GetN(); ++n) {
+        for (uint32_t d = 0; d < nodes.Get(n)->GetNDevices(); ++d) {
+            if (DynamicCast<WifiNetDevice>(nodes.Get(n)->GetDevice(d)))
+                wifiDevices.Add(nodes.Get(n)->GetDevice(d));
+            else if (DynamicCast<CsmaNetDevice>(nodes.Get(n)->GetDevice(d)))
+                csmaDevices.Add(nodes.Get(n)->GetDevice(d));
+        }
+    }
+
+    int64_t stream = 0;
+    WifiHelper wifi;
+    stream += wifi.AssignStreams(wifiDevices, stream);
+    CsmaHelper csma; // backoff
+    stream += csma.AssignStreams(csmaDevices, stream);
+    MobilityHelper mobility;
+    stream += mobility.AssignStreams(nodes, stream);
+    InternetStackHelper internet;
+    if (config.olsrRouting) {
+        OlsrHelper olsr;
+        internet.SetRoutingHelper(olsr);
+    } else {
+        AodvHelper aodv;
+        internet.SetRoutingHelper(aodv);
+    }
+    stream += internet.AssignStreams(nodes, stream);
+    OnOffHelper onoff("ns3::UdpSocketFactory", Address());
+    stream += onoff.AssignStreams(nodes, stream);
+}
+
 void runSim(double simulationTime) {
-    Simulator::Stop(Seconds(simulationTime));
+    Simulator::Stop(Seconds(simulationTime) - Simulator::Now());
+    replicateStopTime = simulationTime;
+    if (steadyState) {
+        // both windows have to lie after the last change, the checks run at the ends of the bins
+        double settled = appStartTime;
+        for (size_t e = 0; e < timedEvents.size(); ++e)
+            settled = std::max(settled, timedEvents[e].time);
+        settled += 2 * steadyWindow;
+        double firstCheck = ceil(settled / binWidth - 1e-9) * binWidth;
+        if (firstCheck < simulationTime)
+            Simulator::Schedule(Seconds(firstCheck) - Simulator::Now(), &steadyStateMonitor, simulationTime);
+    }
+    // a warm-start replicate inherits the events of the untimed prefix, only the ones of this run count
+    uint64_t eventsBefore = Simulator::GetEventCount();
+    PhaseTimer runTimer;
+    runTimer.Start();
     Simulator::Run();
+    runTimer.Stop(benchPhases[PHASE_RUN]);
+    benchPhases[PHASE_RUN].events = Simulator::GetEventCount() - eventsBefore;
     Simulator::Destroy();
 }
 
@@ -308,253 +1645,2154 @@ int main(int argc, char *argv[]) {
 
     // CommandLine arguments
 	double st = 30.0;
+    int makeGraph = 0;
+    std::string graphList;
+    std::string robotCountList = "1,2,5,10,20,50,100,200";
+    std::string sweepRateList;
+    std::string scenarioFile;
     CommandLine cmd;
+    cmd.AddValue("scenario", "Scenario file with [section] and key=value lines; the command line overrides its values", scenarioFile);
     cmd.AddValue("anim", "Generate NetAnim file", doNetanim);
+    cmd.AddValue("animFile", "NetAnim output file", animFile);
+    cmd.AddValue("animStart", "Start of the animated time window (s)", animStart);
+    cmd.AddValue("animStop", "End of the animated time window (s); 0 for the end of the simulation", animStop);
+    cmd.AddValue("animMobilityInterval", "How often node positions are written to the animation (s)", animMobilityInterval);
+    cmd.AddValue("animPackets", "Write packet events to the animation", animPackets);
+    cmd.AddValue("animMetadata", "Write packet metadata to the animation", animMetadata);
+    cmd.AddValue("animMaxMb", "Stop the animation once its file is larger than this (MB), checked every 64 frames and animMobilityInterval; 0 for no limit", animMaxMb);
     cmd.AddValue("simulTime", "Total simulation time", st);
     cmd.AddValue("robotCallbackLogging", "Enable logging of robot callback", logRobotCallback);
-    cmd.AddValue("graph", "[0-9], which graph should be generated; 0 for none", makeGraph);
-    cmd.Parse(argc, argv);
-	simTime = (int) st;
-
-    // prvotne nastavenia v hl.funkcii
-    Gnuplot graf("graf" + std::to_string(makeGraph) + ".svg");
-    if (makeGraph) {
-        graf.SetTerminal("svg");
-        switch (makeGraph) {
-            case 1:
-                graf.SetTitle("Graf zavislosti mnozstva prijatych datovych paketov od casu");
-                graf.SetLegend("Cas [s]", "Mnozstvo prijatych paketov");
-                data.SetTitle("prijate pakety (OLSR 5Mbit)");
-                break;
-            case 2:
-                graf.SetTitle("Graf zavislosti mnozstva prijatych datovych paketov od casu");
-                graf.SetLegend("Cas [s]", "Mnozstvo prijatych paketov");
-                data.SetTitle("prijate pakety (OLSR 5kbit)");
-                break;
-            case 3:
-                graf.SetTitle("Graf zavislosti mnozstva prijatych datovych paketov od casu");
-                graf.SetLegend("Cas [s]", "Mnozstvo prijatych paketov");
-                data.SetTitle("prijate pakety (AODV 5Mbit)");
-                break;
-            case 4:
-                graf.SetTitle("Graf zavislosti mnozstva prijatych datovych paketov od casu");
-                graf.SetLegend("Cas [s]", "Mnozstvo prijatych paketov");
-                data.SetTitle("prijate pakety (AODV 5kbit)");
-                break;
-            case 5:
-                graf.SetTitle("Graf zavislosti podielu prijatych datovych paketov ku vsetkym paketom v case");
-                graf.SetLegend("Cas [s]", "podiel datove pakety ku vsetkym paketom");
-                data.SetTitle("goodput (OLSR 5Mbit)");
-                break;
-            case 6:
-                graf.SetTitle("Graf zavislosti podielu prijatych datovych paketov ku vsetkym paketom v case");
-                graf.SetLegend("Cas [s]", "podiel datove pakety ku vsetkym paketom");
-                data.SetTitle("goodput (OLSR 5kbit)");
-                break;
-            case 7:
-                graf.SetTitle("Graf zavislosti podielu prijatych datovych paketov ku vsetkym paketom v case");
-                graf.SetLegend("Cas [s]", "podiel datove pakety ku vsetkym paketom");
-                data.SetTitle("goodput (AODV 5Mbit)");
-                break;
-            case 8:
-                graf.SetTitle("Graf zavislosti podielu prijatych datovych paketov ku vsetkym paketom v case");
-                graf.SetLegend("Cas [s]", "podiel datove pakety ku vsetkym paketom");
-                data.SetTitle("goodput (AODV 5kbit)");
-                break;
-            case 9:
-                graf.SetTitle("Graf zavislosti poctu prijatych paketov od rychlosti ethernetovej linky");
-                graf.SetLegend("Rychlost [bit/s]", "pocet prijatych paketov za celu simulaciu");
-                data.SetTitle("pocet paketov (AODV)");
-                break;
-        }
+    cmd.AddValue("graph", "[0-12], which graph should be generated; 0 for none", makeGraph);
+    cmd.AddValue("graphs", "Comma separated list of graphs to generate in one run (e.g. 1,5,9), or all", graphList);
+    cmd.AddValue("binWidth", "Width of one measurement bin in seconds", binWidth);
+    cmd.AddValue("keepArrivalTimes", "Also store raw packet arrival times and write them to arrivals.dat", keepArrivalTimes);
+    cmd.AddValue("jobs", "Number of worker processes running replicates in parallel; 0 for one per CPU", nJobs);
+    cmd.AddValue("run", "RNG run number of the first replicate, replicate i uses run+i", firstRun);
+    cmd.AddValue("warmStart", "Simulate the routing convergence before the applications start once per configuration and fork the replicates from it", warmStart);
+    cmd.AddValue("runs", "Replicates per configuration (the minimum with targetRelErr)", runs);
+    cmd.AddValue("targetRelErr", "Add replicates until every 95% confidence interval half width is below this fraction of its mean; 0 for a fixed count", targetRelErr);
+    cmd.AddValue("maxRuns", "Most replicates per configuration with targetRelErr", maxRuns);
+    cmd.AddValue("steadyState", "Stop a replicate once the received packets per steadyWindow are stable after the last scenario change", steadyState);
+    cmd.AddValue("steadyWindow", "Length of the two windows compared by steadyState (s)", steadyWindow);
+    cmd.AddValue("steadyTolerance", "Largest relative difference of the two windows for steadyState", steadyTolerance);
+    cmd.AddValue("steadyMinPackets", "Fewest packets each window needs for steadyState", steadyMinPackets);
+    cmd.AddValue("aps", "Number of access points", nAps);
+    cmd.AddValue("apGridWidth", "Number of access points in one row of the grid", apGridWidth);
+    cmd.AddValue("apSpacing", "Distance between neighbouring access points (m)", apSpacing);
+    cmd.AddValue("serverX", "x of the server (m)", serverX);
+    cmd.AddValue("serverY", "y of the server (m)", serverY);
+    cmd.AddValue("csmaDelay", "Delay of the CSMA LAN between the server and the APs (ms)", csmaDelayMs);
+    cmd.AddValue("backbone", "Wired network between the server and the APs: csma (one LAN) or p2p (a link per AP)", backbone);
+    cmd.AddValue("appStart", "When the robots start sending, routing converges before (s)", appStartTime);
+    cmd.AddValue("wifiRange", "Range of the wifi transmissions (m)", wifiRange);
+    cmd.AddValue("wifiChannel", "yans for the YansWifiChannel, grid for the spatially indexed channel (large AP counts), disc for abstract unit-disc links without 802.11", wifiChannel);
+    cmd.AddValue("discRate", "Link rate of the disc links", discRate);
+    cmd.AddValue("discDelay", "Delay of the disc links on top of the propagation delay (us)", discDelay);
+    cmd.AddValue("calibrate", "Simulate every configuration with the full wifi model and with disc links and compare them in calibration.dat", calibrate);
+    cmd.AddValue("robots", "Number of robots, each sending its own flow to the server", nRobots);
+    cmd.AddValue("sweepRates", "Comma separated CSMA rates (kbit/s) graph 9 starts from; empty for 8 log spaced rates from 1kbit", sweepRateList);
+    cmd.AddValue("sweepBudget", "Simulations graph 9 may use to refine its sweep where the curve bends; 0 for the fixed sweep", sweepBudget);
+    cmd.AddValue("sweepThreshold", "Refine graph 9 between rates whose results differ by more than this fraction of the curve's range", sweepThreshold);
+    cmd.AddValue("robotCounts", "Comma separated robot counts swept by graphs 10 and 11", robotCountList);
+    cmd.AddValue("fenceMinX", "Robots leaving the fence are sent home: lowest x (m)", fenceMinX);
+    cmd.AddValue("fenceMinY", "Lowest y of the fence (m)", fenceMinY);
+    cmd.AddValue("fenceMaxX", "Highest x of the fence (m)", fenceMaxX);
+    cmd.AddValue("fenceMaxY", "Highest y of the fence (m)", fenceMaxY);
+    cmd.AddValue("homeX", "x of the robots' home (m)", homeX);
+    cmd.AddValue("homeY", "y of the robots' home (m)", homeY);
+    cmd.AddValue("homeTolerance", "How close to home on both axes a robot has to get to roam again (m)", homeTolerance);
+    cmd.AddValue("robotSpeed", "Speed of the robots (m/s)", robotSpeed);
+    cmd.AddValue("robotFastSpeed", "Speed of the robots after speedChangeTime (m/s)", robotFastSpeed);
+    cmd.AddValue("speedChangeTime", "When the robots speed up (s)", speedChangeTime);
+    cmd.AddValue("pingOffTime", "Off time of the robots' OnOff applications after pingChangeTime (s)", pingOffTime);
+    cmd.AddValue("pingChangeTime", "When the robots start sending more often (s)", pingChangeTime);
+    cmd.AddValue("events", "Timed changes of all robots, time:attribute=value,... with speed, onTime, offTime or dataRate; replaces the speed and ping changes", eventList);
+    cmd.AddValue("timeSeries", "Four routing:rateKb configurations of graphs 1-4 and 5-8", timeSeriesList);
+    cmd.AddValue("sweepRouting", "Routing of the rate sweep of graph 9: olsr or aodv", sweepRouting);
+    cmd.AddValue("robotSweep", "routing:rateKb configuration of the robot count sweep of graphs 10-12", robotSweepConfig);
+    cmd.AddValue("overhead", "Count frames and bytes per node and class (data, routing, ARP, 802.11 management) into overhead.csv and overhead_nodes.csv", doOverhead);
+    cmd.AddValue("handover", "Detect every change of a robot's next hop and write the outage, time to the first delivery and routing frames spent per event into handover.csv", doHandover);
+    cmd.AddValue("scheduler", "Event scheduler: map, list, heap or calendar", scheduler);
+    cmd.AddValue("schedulerBench", "Compare all schedulers on a matrix of AP counts, routing protocols and robot counts, written to scheduler_bench.csv", schedulerBench);
+    cmd.AddValue("benchAps", "Comma separated AP counts of the scheduler benchmark", benchApList);
+    cmd.AddValue("benchRobots", "Comma separated robot counts of the scheduler benchmark", benchRobotList);
+    cmd.AddValue("plotter", "How the graphs are rendered: gnuplot (background processes, started as soon as graphs are final), svg (written directly) or none", plotter);
+    cmd.AddValue("bench", "Measure wall time, CPU time, peak RSS and event rate of every phase and write them to benchFile", doBench);
+    cmd.AddValue("benchFile", "JSON file written by --bench", benchFile);
+    cmd.AddValue("store", "Directory to write the raw measurements of every replicate into, one columnar file each", storeDir);
+    cmd.AddValue("aggregate", "Build the graphs from the replicates in this store directory instead of simulating", aggregateDir);
+    cmd.AddValue("cache", "Directory for cached replicate results, reused by later runs; empty disables the cache", cacheDir);
+
+    // the scenario file is turned into arguments in front of the real ones, so that those override it
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 11, "--scenario=") == 0)
+            scenarioFile = arg.substr(11);
+    }
+    std::vector<std::string> args(1, argv[0]);
+    if (!scenarioFile.empty() && !loadScenario(scenarioFile, args))
+        return -1;
+    args.insert(args.end(), argv + 1, argv + argc);
+    std::vector<char *> allArgv;
+    for (size_t i = 0; i < args.size(); ++i)
+        allArgv.push_back(&args[i][0]);
+    cmd.Parse(allArgv.size(), allArgv.data());
+
+    if (animStart < 0.0 || animStop < 0.0 || (animStop > 0.0 && animStop <= animStart) || animMobilityInterval <= 0.0 || animMaxMb < 0.0) {
+        std::cerr << "the animation window has to end after it starts, animMobilityInterval has to be positive and animMaxMb not negative" << std::endl;
+        return -1;
+    }
 
-        if (makeGraph >= 1 && makeGraph <= 8)
-            graf.AppendExtra("set xrange[0:32]");
-        if (makeGraph == 9) {
-            graf.AppendExtra("set logscale x");
-            graf.AppendExtra("set xrange[1000:5000000]");
-        }
+    if (warmStart && doNetanim) {
+        std::cerr << "warmStart cannot be combined with anim" << std::endl;
+        return -1;
+    }
 
-        data.SetStyle(Gnuplot2dDataset::LINES); // use LINES_POINTS if you want to have errorbars with the line in one dataset
-        // Two lines because if the errorbars have the same color as the line it looks ugly
-        errorBars.SetTitle("smerodajna odchylka");
-        errorBars.SetStyle(Gnuplot2dDataset::POINTS);
-        errorBars.SetErrorBars(Gnuplot2dDataset::Y);
+    if (csmaDelayMs < 0.0 || appStartTime < 0.0 || appStartTime >= st - 1) {
+        std::cerr << "csmaDelay has to be non-negative and appStart before simulTime - 1" << std::endl;
+        return -1;
     }
 
-    // How many times will the simulation be run?
-    uint64_t nRuns;
-    if (makeGraph > 0 && makeGraph < 10)
-        nRuns = 10;
-    else if (makeGraph == 0)
-        nRuns = 1;
-    else {
-        std::cerr << "makeGraph has to be from interval <0; 9>" << std::endl;
+    if (plotter != "gnuplot" && plotter != "svg" && plotter != "none") {
+        std::cerr << "plotter has to be gnuplot, svg or none" << std::endl;
         return -1;
     }
 
-    // Manage RNG seeds
-    RngSeedManager seedManager;
-    seedManager.SetRun(nRuns);
+    if (binWidth <= 0.0) {
+        std::cerr << "binWidth has to be positive" << std::endl;
+        return -1;
+    }
 
-    // Simulation parameters
-    uint64_t dataRatekb;
-    bool olsrRouting;
-    switch (makeGraph) {
-        case 1:
-        case 5:
-        default:
-            dataRatekb = 5000; // in kilo bits
-            olsrRouting = true; // false = AODV
-            break;
-        case 2:
-        case 6:
-            dataRatekb = 5;
-            olsrRouting = true;
-            break;
+    if (steadyWindow < binWidth || steadyTolerance < 0.0) {
+        std::cerr << "steadyWindow has to be at least binWidth and steadyTolerance not negative" << std::endl;
+        return -1;
+    }
+
+    if (nAps < 1 || apGridWidth < 1 || nAps > 65000) {
+        std::cerr << "aps has to be from interval <1; 65000> and apGridWidth positive" << std::endl;
+        return -1;
+    }
+    std::vector<int> counts = parseList(robotCountList);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] < 1) {
+            std::cerr << "robot counts have to be positive" << std::endl;
+            return -1;
+        }
+        robotCounts.push_back(counts[i]);
+    }
+    if (nRobots < 1 || robotCounts.empty()) {
+        std::cerr << "robots has to be positive and robotCounts not empty" << std::endl;
+        return -1;
+    }
+    if (wifiChannel != "yans" && wifiChannel != "grid" && wifiChannel != "disc") {
+        std::cerr << "wifiChannel has to be yans, grid or disc" << std::endl;
+        return -1;
+    }
+    if (doHandover && wifiChannel == "disc") {
+        std::cerr << "handover follows 802.11 frames and cannot be combined with wifiChannel=disc" << std::endl;
+        return -1;
+    }
+    if (backbone != "csma" && backbone != "p2p") {
+        std::cerr << "backbone has to be csma or p2p" << std::endl;
+        return -1;
+    }
+
+    // what the graphs simulate and when the robots change
+    std::stringstream seriesList(timeSeriesList);
+    std::string entry;
+    while (std::getline(seriesList, entry, ',')) {
+        SimulationConfig config;
+        if (!parseConfig(entry, config)) {
+            std::cerr << "cannot read time series " << entry << ", expected olsr or aodv:rateKb" << std::endl;
+            return -1;
+        }
+        timeSeries.push_back(config);
+    }
+    if (timeSeries.size() != 4) {
+        std::cerr << "timeSeries needs four configurations, one for each of graphs 1-4 and 5-8" << std::endl;
+        return -1;
+    }
+    if (!parseConfig(robotSweepConfig, robotSweep)) {
+        std::cerr << "robotSweep has to be olsr or aodv:rateKb" << std::endl;
+        return -1;
+    }
+    if (sweepRouting != "olsr" && sweepRouting != "aodv") {
+        std::cerr << "sweepRouting has to be olsr or aodv" << std::endl;
+        return -1;
+    }
+    if (eventList.empty()) {
+        timedEvents.push_back({speedChangeTime, "speed", std::to_string(robotFastSpeed)});
+        timedEvents.push_back({pingChangeTime, "offTime", std::to_string(pingOffTime)});
+    } else if (!parseEvents(eventList, timedEvents)) {
+        return -1;
+    }
+
+    // coarse sweep, evenly spaced (on log scale) from 1kbit to ~3Mbit, unless given
+    std::vector<int> rates = parseList(sweepRateList);
+    for (size_t i = 0; i < rates.size(); ++i) {
+        if (rates[i] < 1) {
+            std::cerr << "sweep rates have to be positive" << std::endl;
+            return -1;
+        }
+        sweepRates.push_back(rates[i]);
+    }
+    for (int outer = 0; sweepRates.empty() && outer < 8; ++outer)
+        sweepRates.push_back(pow(10.0, 0.5 * outer));
+    std::sort(sweepRates.begin(), sweepRates.end());
+    sweepRates.erase(std::unique(sweepRates.begin(), sweepRates.end()), sweepRates.end());
+    if (sweepThreshold <= 0.0) {
+        std::cerr << "sweepThreshold has to be positive" << std::endl;
+        return -1;
+    }
+
+    if (runs < 2 || maxRuns < runs || targetRelErr < 0.0) {
+        std::cerr << "runs has to be at least 2, maxRuns at least runs and targetRelErr not negative" << std::endl;
+        return -1;
+    }
+
+    if (schedulerType(scheduler).empty()) {
+        std::cerr << "scheduler has to be map, list, heap or calendar" << std::endl;
+        return -1;
+    }
+    GlobalValue::Bind("SchedulerType", StringValue(schedulerType(scheduler)));
+
+    if (nJobs == 0)
+        nJobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nJobs < 1) {
+        std::cerr << "jobs has to be a positive number (or 0 for one per CPU)" << std::endl;
+        return -1;
+    }
+
+    // Which graphs should be generated?
+    if (graphList == "all") {
+        for (int g = 1; g <= nGraphs; ++g)
+            graphs.push_back(g);
+    } else if (!graphList.empty()) {
+        std::vector<int> list = parseList(graphList);
+        for (size_t g = 0; g < list.size(); ++g) {
+            if (std::find(graphs.begin(), graphs.end(), list[g]) == graphs.end())
+                graphs.push_back(list[g]);
+        }
+    } else if (makeGraph != 0) {
+        graphs.push_back(makeGraph);
+    }
+    for (size_t g = 0; g < graphs.size(); ++g) {
+        if (graphs[g] < 1 || graphs[g] > nGraphs) {
+            std::cerr << "makeGraph has to be from interval <0; " << nGraphs << ">" << std::endl;
+            return -1;
+        }
+    }
+
+    // Graphs sharing a configuration share its simulations
+    std::vector<SimulationConfig> configs;
+    if (graphs.empty())
+        configs = graphConfigurations(0);
+    for (size_t g = 0; g < graphs.size(); ++g) {
+        std::vector<SimulationConfig> needed = graphConfigurations(graphs[g]);
+        for (size_t c = 0; c < needed.size(); ++c) {
+            if (findConfig(configs, needed[c]) == configs.size())
+                configs.push_back(needed[c]);
+        }
+    }
+
+    // How many times will the simulation be run? With targetRelErr at least runs times, more while the
+    // confidence intervals are too wide
+    uint64_t nRuns = graphs.empty() ? 1 : runs;
+    bool sequential = targetRelErr > 0 && !graphs.empty();
+
+    if (calibrate)
+        return runCalibration(configs, nRuns, st) ? 0 : -1;
+    if (schedulerBench)
+        return runSchedulerBench(st) ? 0 : -1;
+
+    // Perform simulations; every replicate gets its own worker process and RNG run.
+    // All configurations of a round share one pool of workers.
+    PhaseMeasurement simulatePhase = PhaseMeasurement(), aggregationPhase = PhaseMeasurement(), plotPhase = PhaseMeasurement();
+    PhaseTimer parentTimer;
+    parentTimer.Start();
+    std::vector<SimulationTask> simulated;
+    std::vector<ReplicateResult> simulatedResults;
+    std::vector<std::vector<size_t> > configReplicates(configs.size()); // indexes into simulated
+    std::vector<size_t> configRuns(configs.size(), nRuns); // replicates used by the graphs
+    std::vector<SimulationTask> round;
+
+    // A graph is built and handed to gnuplot as soon as its configurations get no more replicates, so that it renders
+    // while the others still simulate; graph 9 waits for the sweep refinement
+    std::vector<bool> graphBuilt(graphs.size(), false);
+    std::vector<pid_t> plotPids;
+    auto renderGraphs = [&](const std::vector<size_t> &active, bool last) {
+        std::vector<std::string> plotFiles;
+        for (size_t g = 0; g < graphs.size(); ++g) {
+            std::vector<SimulationConfig> needed = graphConfigurations(graphs[g]);
+            bool ready = last || graphs[g] != 9 || sweepBudget == 0;
+            for (size_t c = 0; ready && c < needed.size(); ++c)
+                ready = std::find(active.begin(), active.end(), findConfig(configs, needed[c])) == active.end();
+            if (graphBuilt[g] || !ready)
+                continue;
+            graphBuilt[g] = true;
+
+            parentTimer.Start();
+            GraphOutput graph;
+            setupGraph(graph, graphs[g]);
+            buildGraph(graph, configs, configRuns, configReplicates, simulatedResults);
+            std::string plotName = "graf" + std::to_string(graph.id);
+            std::ofstream plotFile(plotName + ".plt");
+            graph.plot.GenerateOutput(plotFile);
+            plotFile.close();
+            plotFiles.push_back(plotName + ".plt");
+            parentTimer.Stop(aggregationPhase);
+
+            if (plotter == "svg") {
+                parentTimer.Start();
+                writeSvgGraph(graph, plotName + ".svg");
+                parentTimer.Stop(plotPhase);
+            }
+        }
+        if (plotter == "gnuplot" && !plotFiles.empty()) {
+            pid_t pid = startGnuplot(plotFiles, "grafy" + std::to_string(plotPids.size() + 1) + ".plt");
+            if (pid > 0)
+                plotPids.push_back(pid);
+        }
+    };
+
+    if (!aggregateDir.empty()) {
+        if (!loadStore(configs, st, simulated, simulatedResults, configReplicates))
+            return -1;
+        for (size_t c = 0; c < configs.size(); ++c)
+            configRuns[c] = configReplicates[c].size();
+    }
+    for (size_t c = 0; aggregateDir.empty() && c < configs.size(); ++c) {
+        for (uint64_t i = 0; i < nRuns; i++) {
+            SimulationTask task = {configs[c], i};
+            round.push_back(task);
+        }
+    }
+    while (!round.empty()) {
+        std::vector<ReplicateResult> roundResults;
+        if (!runReplicates(round, st, roundResults))
+            return -1;
+        for (size_t r = 0; r < round.size(); ++r) {
+            configReplicates[findConfig(configs, round[r].config)].push_back(simulated.size());
+            simulated.push_back(round[r]);
+            simulatedResults.push_back(roundResults[r]);
+        }
+        round.clear();
+
+        // Stopping is decided on replicate prefixes in index order, so the replicate counts do not depend
+        // on how many replicates a round launched; the ones simulated past the stopping point are dropped.
+        std::vector<size_t> active;
+        if (sequential) {
+            for (size_t c = 0; c < configs.size(); ++c) {
+                configRuns[c] = convergedRuns(configs[c], simulatedResults, configReplicates[c]);
+                if (configRuns[c] == 0 && configReplicates[c].size() < maxRuns)
+                    active.push_back(c);
+                else if (configRuns[c] == 0)
+                    configRuns[c] = maxRuns;
+            }
+            size_t batch = std::max((size_t) 1, (nJobs + active.size() - 1) / std::max(active.size(), (size_t) 1));
+            for (size_t a = 0; a < active.size(); ++a) {
+                size_t c = active[a];
+                for (size_t i = configReplicates[c].size(); i < configReplicates[c].size() + batch && i < maxRuns; ++i) {
+                    SimulationTask task = {configs[c], i};
+                    round.push_back(task);
+                }
+            }
+        }
+        parentTimer.Stop(simulatePhase);
+        renderGraphs(active, false);
+        parentTimer.Start();
+        if (!round.empty() || sweepBudget == 0 || std::find(graphs.begin(), graphs.end(), 9) == graphs.end())
+            continue;
+
+        // once every configuration is done, graph 9 gets new data rates where its curve needs them
+        std::vector<SimulationConfig> sweep = graphConfigurations(9);
+        std::vector<RunningStats> sweepPoints(sweep.size());
+        size_t used = 0; // only the replicates the graph uses, the ones past the stopping point depend on jobs
+        for (size_t p = 0; p < sweep.size(); ++p) {
+            size_t c = findConfig(configs, sweep[p]);
+            used += configRuns[c];
+            for (size_t i = 0; i < configRuns[c]; ++i)
+                sweepPoints[p].Add(graphSeries(9, simulatedResults[configReplicates[c][i]]).at(0));
+        }
+        // with targetRelErr every new rate may take up to maxRuns replicates in the following rounds
+        size_t perRate = sequential ? maxRuns : nRuns;
+        std::vector<uint64_t> rates = refineSweep(sweepPoints, used < sweepBudget ? (sweepBudget - used) / perRate : 0);
+        for (size_t r = 0; r < rates.size(); ++r) {
+            sweepRates.insert(std::upper_bound(sweepRates.begin(), sweepRates.end(), rates[r]), rates[r]);
+            SimulationConfig config = sweep[0];
+            config.dataRatekb = rates[r];
+            configs.push_back(config);
+            configReplicates.push_back(std::vector<size_t>());
+            configRuns.push_back(nRuns);
+            for (uint64_t i = 0; i < nRuns; i++) {
+                SimulationTask task = {config, i};
+                round.push_back(task);
+            }
+        }
+    }
+    parentTimer.Stop(simulatePhase);
+
+    // the replicates used by the graphs, laid out config after config
+    std::vector<SimulationTask> tasks;
+    std::vector<ReplicateResult> results;
+    std::vector<size_t> configFirst(configs.size());
+    for (size_t c = 0; c < configs.size(); ++c) {
+        configFirst[c] = tasks.size();
+        for (size_t i = 0; i < configRuns[c]; ++i) {
+            tasks.push_back(simulated[configReplicates[c][i]]);
+            results.push_back(simulatedResults[configReplicates[c][i]]);
+        }
+        if (sequential) {
+            std::cout << configLabel(configs[c]) << ": " << configRuns[c] << " replicates" << (configRuns[c] >= maxRuns ? " (maxRuns reached)" : "") << std::endl;
+        }
+        if (steadyState) {
+            double stopSum = 0.0;
+            size_t stopped = 0;
+            for (size_t t = configFirst[c]; t < results.size(); ++t) {
+                stopSum += results[t].stopTime;
+                stopped += results[t].stopTime < results[t].endTime;
+            }
+            std::cout << configLabel(configs[c]) << ": " << stopped << " of " << configRuns[c] << " replicates stopped in steady state, on average at "
+                      << stopSum / configRuns[c] << " s" << std::endl;
+        }
+    }
+    // gnuplot renders the last graphs while the reports are written, only the wait for it counts as the plot phase
+    renderGraphs(std::vector<size_t>(), true);
+
+    if (!storeDir.empty() && aggregateDir.empty()) {
+        for (size_t t = 0; t < tasks.size(); ++t)
+            writeStoredResult(tasks[t], results[t], st);
+    }
+
+    // per robot statistics of a single run
+    if (graphs.empty()) {
+        const ReplicateResult &result = results[0];
+        for (size_t i = 0; i < result.robotPacketsSent.size(); ++i)
+            std::cout << "robot " << i << ": " << result.robotPacketsSent[i] << " packets sent, " << result.robotPacketsReceived[i] << " received by the server" << std::endl;
+    }
+    writeLatencyReport(tasks, results);
+    if (doOverhead)
+        writeOverheadReport(tasks, results);
+    if (doHandover)
+        writeHandoverReport(tasks, results);
+
+    if (keepArrivalTimes && !graphs.empty()) {
+        std::ofstream arrivalsFile("arrivals.dat");
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            arrivalsFile << "# " << configLabel(tasks[t].config) << ", replicate " << tasks[t].replicate << std::endl;
+            arrivalsFile << "# application packets" << std::endl;
+            for (size_t j = 0; j < results[t].arrivalTimes.size(); ++j)
+                arrivalsFile << results[t].arrivalTimes[j] << std::endl;
+            arrivalsFile << std::endl << std::endl << "# all packets" << std::endl;
+            for (size_t j = 0; j < results[t].allPacketsArrivalTimes.size(); ++j)
+                arrivalsFile << results[t].allPacketsArrivalTimes[j] << std::endl;
+            arrivalsFile << std::endl << std::endl;
+        }
+    }
+
+    for (size_t i = 0; i < plotPids.size(); ++i) {
+        parentTimer.Start();
+        int status = 0;
+        while (waitpid(plotPids[i], &status, 0) < 0 && errno == EINTR);
+        parentTimer.Stop(plotPhase);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            std::cerr << "gnuplot failed, the graphs can be rendered again from the .plt files" << std::endl;
+    }
+
+    if (doBench)
+        writeBenchReport(tasks, results, simulatePhase, aggregationPhase, plotPhase);
+    return 0;
+}
+
+static std::string schedulerType(const std::string &name) {
+    if (name == "map")
+        return "ns3::MapScheduler";
+    if (name == "list")
+        return "ns3::ListScheduler";
+    if (name == "heap")
+        return "ns3::HeapScheduler";
+    if (name == "calendar")
+        return "ns3::CalendarScheduler";
+    return "";
+}
+
+// One replicate of every AP count x routing x robot count with every scheduler, never from the cache. The run phase
+// is timed, so use --jobs=1 for undisturbed numbers.
+bool runSchedulerBench(double simulationTime) {
+    const char *schedulers[4] = {"map", "list", "heap", "calendar"};
+    std::vector<int> apCounts = parseList(benchApList), robotCountsBench = parseList(benchRobotList);
+    cacheDir = "";
+
+    std::ofstream out("scheduler_bench.csv");
+    out << "scheduler,aps,routing,robots,events,runSeconds,eventsPerSecond,peakRssKb" << std::endl;
+    for (size_t a = 0; a < apCounts.size(); ++a) {
+        if (apCounts[a] < 1)
+            continue;
+        nAps = apCounts[a];
+        apGridWidth = (uint32_t) ceil(sqrt((double) nAps));
+
+        std::vector<SimulationTask> tasks;
+        for (int olsr = 1; olsr >= 0; --olsr) {
+            for (size_t r = 0; r < robotCountsBench.size(); ++r) {
+                SimulationTask task = {{olsr == 1, 5000, (uint32_t) std::max(1, robotCountsBench[r])}, 0};
+                tasks.push_back(task);
+            }
+        }
+
+        std::vector<ReplicateResult> results[4];
+        for (int k = 0; k < 4; ++k) {
+            GlobalValue::Bind("SchedulerType", StringValue(schedulerType(schedulers[k])));
+            if (!runReplicates(tasks, simulationTime, results[k]))
+                return false;
+        }
+
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            int best = 0;
+            double bestRate = 0.0;
+            for (int k = 0; k < 4; ++k) {
+                const PhaseMeasurement &run = results[k][t].phases.at(PHASE_RUN);
+                double rate = run.wallSeconds > 0 ? run.events / run.wallSeconds : 0.0;
+                out << schedulers[k] << "," << nAps << "," << (tasks[t].config.olsrRouting ? "olsr" : "aodv") << "," << tasks[t].config.nRobots
+                    << "," << run.events << "," << run.wallSeconds << "," << rate << "," << run.peakRssKb << std::endl;
+                if (rate > bestRate) {
+                    best = k;
+                    bestRate = rate;
+                }
+            }
+            std::cout << nAps << " APs, " << (tasks[t].config.olsrRouting ? "OLSR, " : "AODV, ") << tasks[t].config.nRobots << " robots: "
+                      << schedulers[best] << " scheduler is fastest (" << bestRate << " events/s)" << std::endl;
+        }
+    }
+    GlobalValue::Bind("SchedulerType", StringValue(schedulerType(scheduler)));
+    std::cout << "scheduler benchmark written to scheduler_bench.csv" << std::endl;
+    return true;
+}
+
+// Simulates every configuration with the full wifi model (yans, or grid if chosen) and with disc links and writes
+// the means and standard deviations of the main results of both, with the speedup of disc, to calibration.dat
+bool runCalibration(const std::vector<SimulationConfig> &configs, uint64_t nRuns, double simulationTime) {
+    std::vector<SimulationTask> tasks;
+    for (size_t c = 0; c < configs.size(); ++c) {
+        for (uint64_t i = 0; i < nRuns; i++) {
+            SimulationTask task = {configs[c], i};
+            tasks.push_back(task);
+        }
+    }
+
+    const char *modes[2] = {wifiChannel == "grid" ? "grid" : "yans", "disc"};
+    std::vector<ReplicateResult> results[2];
+    for (int m = 0; m < 2; ++m) {
+        wifiChannel = modes[m];
+        if (!runReplicates(tasks, simulationTime, results[m]))
+            return false;
+    }
+
+    const int nMetrics = 6;
+    const char *metrics[nMetrics] = {"received", "allPackets", "goodput", "delayP50ms", "delayP99ms", "runSeconds"};
+    std::ofstream out("calibration.dat");
+    out << "# routing csmaRateKb robots metric " << modes[0] << "Mean " << modes[0] << "StdDev disc discStdDev relativeDifference" << std::endl;
+    for (size_t c = 0; c < configs.size(); ++c) {
+        RunningStats stats[2][nMetrics];
+        for (int m = 0; m < 2; ++m) {
+            for (uint64_t i = 0; i < nRuns; ++i) {
+                const ReplicateResult &result = results[m][c * nRuns + i];
+                LogHistogram delays;
+                delays.Reset();
+                delays.Merge(result.delayBuckets);
+                stats[m][0].Add(result.packetsTotal);
+                stats[m][1].Add(result.allPacketsTotal);
+                stats[m][2].Add(result.allPacketsTotal != 0 ? result.packetsTotal / (double) result.allPacketsTotal : 0);
+                stats[m][3].Add(delays.Percentile(0.5) / 1000.0);
+                stats[m][4].Add(delays.Percentile(0.99) / 1000.0);
+                stats[m][5].Add(result.phases.size() == N_WORKER_PHASES ? result.phases[PHASE_RUN].wallSeconds : 0.0);
+            }
+        }
+        for (int k = 0; k < nMetrics; ++k) {
+            double full = stats[0][k].mean, disc = stats[1][k].mean;
+            out << (configs[c].olsrRouting ? "olsr " : "aodv ") << configs[c].dataRatekb << " " << configs[c].nRobots << " " << metrics[k]
+                << " " << full << " " << stats[0][k].StdDev() << " " << disc << " " << stats[1][k].StdDev()
+                << " " << (full != 0.0 ? (disc - full) / full : 0.0) << std::endl;
+        }
+        std::cout << configLabel(configs[c]) << ": disc received "
+                  << stats[1][0].mean << " packets vs " << stats[0][0].mean << ", "
+                  << (stats[1][5].mean > 0.0 ? stats[0][5].mean / stats[1][5].mean : 0.0) << "x faster" << std::endl;
+    }
+    std::cout << "calibration written to calibration.dat" << std::endl;
+    return true;
+}
+
+// overhead.csv (per time bin) and overhead_nodes.csv (per node): frames and bytes sent per class, averaged over
+// the replicates of every configuration
+void writeOverheadReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results) {
+    std::ofstream series("overhead.csv"), nodes("overhead_nodes.csv");
+    series << "routing,csmaRateKb,robots,replicates,time,class,frames,bytes" << std::endl;
+    nodes << "routing,csmaRateKb,robots,replicates,node,class,frames,bytes" << std::endl;
+
+    for (size_t first = 0, last = 0; first < tasks.size(); first = last) {
+        std::vector<double> binFrames, binBytes, nodeFrames, nodeBytes;
+        for (last = first; last < tasks.size() && sameConfig(tasks[last].config, tasks[first].config); ++last) {
+            addCounts(binFrames, results[last].overheadBinFrames);
+            addCounts(binBytes, results[last].overheadBinBytes);
+            addCounts(nodeFrames, results[last].overheadNodeFrames);
+            addCounts(nodeBytes, results[last].overheadNodeBytes);
+        }
+
+        std::ostringstream config;
+        config << (tasks[first].config.olsrRouting ? "olsr," : "aodv,") << tasks[first].config.dataRatekb << ","
+               << tasks[first].config.nRobots << "," << last - first << ",";
+        for (size_t i = 0; i < binFrames.size(); ++i) {
+            series << config.str() << (i / N_CLASSES) * binWidth << "," << packetClassNames[i % N_CLASSES] << ","
+                   << binFrames[i] / (last - first) << "," << binBytes[i] / (last - first) << std::endl;
+        }
+        for (size_t i = 0; i < nodeFrames.size(); ++i) {
+            nodes << config.str() << i / N_CLASSES << "," << packetClassNames[i % N_CLASSES] << ","
+                  << nodeFrames[i] / (last - first) << "," << nodeBytes[i] / (last - first) << std::endl;
+        }
+    }
+}
+
+// handover_events.csv: every handover of every replicate; handover.csv: the distribution of each metric per
+// routing protocol over all configurations, unrepaired handovers only count towards the outage
+void writeHandoverReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results) {
+    std::ofstream events("handover_events.csv"), summary("handover.csv");
+    events << "routing,csmaRateKb,robots,replicate,robot,time,changes,outage,firstDelivery,controlFrames" << std::endl;
+    summary << "routing,metric,events,mean,p50,p90,p99,max" << std::endl;
+
+    for (int olsr = 1; olsr >= 0; --olsr) {
+        std::string routing = olsr ? "olsr" : "aodv";
+        std::vector<double> outage, firstDelivery, controlFrames, unrepaired;
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            if (tasks[t].config.olsrRouting != (olsr == 1))
+                continue;
+            for (size_t i = 0; i < results[t].handovers.size(); ++i) {
+                const HandoverEvent &event = results[t].handovers[i];
+                events << routing << "," << tasks[t].config.dataRatekb << "," << tasks[t].config.nRobots << "," << tasks[t].replicate
+                       << "," << event.robot << "," << event.time << "," << event.changes << "," << event.outage << ","
+                       << event.firstDelivery << "," << event.controlFrames << std::endl;
+                outage.push_back(event.outage);
+                if (event.firstDelivery >= 0.0) {
+                    firstDelivery.push_back(event.firstDelivery);
+                    controlFrames.push_back(event.controlFrames);
+                } else {
+                    unrepaired.push_back(event.outage);
+                }
+            }
+        }
+        writeDistribution(summary, routing, "outage", outage);
+        writeDistribution(summary, routing, "firstDelivery", firstDelivery);
+        writeDistribution(summary, routing, "controlFrames", controlFrames);
+        writeDistribution(summary, routing, "unrepairedOutage", unrepaired);
+    }
+    std::cout << "handovers written to handover.csv and handover_events.csv" << std::endl;
+}
+
+// nearest rank percentiles, the values are sorted here
+static void writeDistribution(std::ostream &out, const std::string &routing, const std::string &metric, std::vector<double> values) {
+    out << routing << "," << metric << "," << values.size();
+    if (values.empty()) {
+        out << ",,,,," << std::endl;
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); ++i)
+        sum += values[i];
+    const double quantiles[] = {0.5, 0.9, 0.99};
+    out << "," << sum / values.size();
+    for (size_t q = 0; q < 3; ++q)
+        out << "," << values[std::min(values.size() - 1, (size_t) ceil(quantiles[q] * values.size()) - 1)];
+    out << "," << values.back() << std::endl;
+}
+
+static void addCounts(std::vector<double> &sum, const std::vector<uint64_t> &counts) {
+    if (sum.size() < counts.size())
+        sum.resize(counts.size(), 0.0);
+    for (size_t i = 0; i < counts.size(); ++i)
+        sum[i] += counts[i];
+}
+
+// latency.dat: delay and jitter percentiles, loss and reordering of every replicate, then of every configuration
+void writeLatencyReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results) {
+    std::ofstream out("latency.dat");
+    out << "# routing csmaRateKb robots replicate received lost reordered delayP50 delayP99 delayP99.9 jitterP50 jitterP99 [ms]" << std::endl;
+
+    size_t first = 0;
+    for (size_t t = 0; t <= tasks.size(); ++t) {
+        // after the last replicate of a configuration, all of its replicates together
+        if (t == tasks.size() || (t > first && !sameConfig(tasks[t].config, tasks[first].config))) {
+            if (t == first)
+                break;
+            out << "# " << configLabel(tasks[first].config) << ", " << t - first << " replicates" << std::endl;
+            writeLatencyLine(out, tasks[first], results.begin() + first, results.begin() + t, -1);
+            out << std::endl << std::endl;
+            first = t;
+            if (t == tasks.size())
+                break;
+        }
+        writeLatencyLine(out, tasks[t], results.begin() + t, results.begin() + t + 1, tasks[t].replicate);
+    }
+}
+
+static void writeLatencyLine(std::ostream &out, const SimulationTask &task, std::vector<ReplicateResult>::const_iterator begin,
+        std::vector<ReplicateResult>::const_iterator end, int64_t replicate) {
+    LogHistogram delays, jitter;
+    delays.Reset();
+    jitter.Reset();
+    uint64_t sent = 0, received = 0, reordered = 0;
+    for (std::vector<ReplicateResult>::const_iterator result = begin; result != end; ++result) {
+        delays.Merge(result->delayBuckets);
+        jitter.Merge(result->jitterBuckets);
+        for (size_t i = 0; i < result->robotPacketsSent.size(); ++i) {
+            sent += result->robotPacketsSent[i];
+            received += result->robotPacketsReceived[i];
+        }
+        reordered += result->packetsReordered;
+    }
+    out << (task.config.olsrRouting ? "olsr " : "aodv ") << task.config.dataRatekb << " " << task.config.nRobots << " ";
+    if (replicate < 0)
+        out << "all";
+    else
+        out << replicate;
+    out << " " << received << " " << (sent > received ? sent - received : 0) << " " << reordered;
+    for (size_t i = 0; i < 3; ++i)
+        out << " " << delays.Percentile(latencyPercentiles[i]) / 1000.0;
+    out << " " << jitter.Percentile(0.5) / 1000.0 << " " << jitter.Percentile(0.99) / 1000.0 << std::endl;
+}
+
+static void writePhaseJson(std::ostream &out, const PhaseMeasurement &phase, bool withEvents) {
+    out << "{\"wallSeconds\": " << phase.wallSeconds
+        << ", \"cpuSeconds\": " << phase.cpuSeconds
+        << ", \"peakRssKb\": " << phase.peakRssKb;
+    if (withEvents) {
+        out << ", \"events\": " << phase.events
+            << ", \"eventsPerSecond\": " << (phase.wallSeconds > 0 ? phase.events / phase.wallSeconds : 0.0);
+    }
+    out << "}";
+}
+
+static void writeStatsJson(std::ostream &out, const std::vector<double> &values) {
+    double sum = 0.0, minimum = 0.0, maximum = 0.0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        sum += values[i];
+        minimum = i == 0 ? values[i] : std::min(minimum, values[i]);
+        maximum = i == 0 ? values[i] : std::max(maximum, values[i]);
+    }
+    out << "{\"mean\": " << (values.empty() ? 0.0 : sum / values.size())
+        << ", \"min\": " << minimum
+        << ", \"max\": " << maximum
+        << ", \"total\": " << sum << "}";
+}
+
+void writeBenchReport(const std::vector<SimulationTask> &tasks, const std::vector<ReplicateResult> &results,
+        const PhaseMeasurement &simulatePhase, const PhaseMeasurement &aggregationPhase, const PhaseMeasurement &plotPhase) {
+    std::ofstream out(benchFile.c_str());
+    out << std::setprecision(9) << "{" << std::endl << "  \"replicates\": [";
+
+    // per replicate; replicates loaded from the cache were not measured in this run
+    std::vector<double> wall[N_WORKER_PHASES], cpu[N_WORKER_PHASES], rss[N_WORKER_PHASES], eventRate;
+    bool first = true;
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        if (results[t].fromCache || results[t].phases.size() != N_WORKER_PHASES)
+            continue;
+
+        out << (first ? "" : ",") << std::endl
+            << "    {\"routing\": \"" << (tasks[t].config.olsrRouting ? "olsr" : "aodv") << "\""
+            << ", \"csmaRateKb\": " << tasks[t].config.dataRatekb
+            << ", \"robots\": " << tasks[t].config.nRobots
+            << ", \"replicate\": " << tasks[t].replicate
+            << ", \"run\": " << firstRun + tasks[t].replicate
+            << ", \"stopTime\": " << results[t].stopTime;
+        for (int p = 0; p < N_WORKER_PHASES; ++p) {
+            const PhaseMeasurement &phase = results[t].phases[p];
+            out << ", \"" << benchPhaseNames[p] << "\": ";
+            writePhaseJson(out, phase, p == PHASE_RUN);
+            wall[p].push_back(phase.wallSeconds);
+            cpu[p].push_back(phase.cpuSeconds);
+            rss[p].push_back(phase.peakRssKb);
+        }
+        out << "}";
+        const PhaseMeasurement &run = results[t].phases[PHASE_RUN];
+        eventRate.push_back(run.wallSeconds > 0 ? run.events / run.wallSeconds : 0.0);
+        first = false;
+    }
+    out << std::endl << "  ]," << std::endl;
+
+    // across replicates
+    out << "  \"summary\": {\"replicates\": " << eventRate.size();
+    for (int p = 0; p < N_WORKER_PHASES; ++p) {
+        out << "," << std::endl << "    \"" << benchPhaseNames[p] << "\": {\"wallSeconds\": ";
+        writeStatsJson(out, wall[p]);
+        out << ", \"cpuSeconds\": ";
+        writeStatsJson(out, cpu[p]);
+        out << ", \"peakRssKb\": ";
+        writeStatsJson(out, rss[p]);
+        if (p == PHASE_RUN) {
+            out << ", \"eventsPerSecond\": ";
+            writeStatsJson(out, eventRate);
+        }
+        out << "}";
+    }
+    out << std::endl << "  }," << std::endl;
+
+    // the parent process: the worker pool as a whole, building the graphs and running gnuplot
+    out << "  \"parent\": {\"jobs\": " << nJobs << ", \"simulate\": ";
+    writePhaseJson(out, simulatePhase, false);
+    out << ", \"aggregation\": ";
+    writePhaseJson(out, aggregationPhase, false);
+    out << ", \"plot\": ";
+    writePhaseJson(out, plotPhase, false);
+    out << "}" << std::endl << "}" << std::endl;
+
+    std::cout << "benchmark written to " << benchFile << std::endl;
+}
+
+// Keys a scenario file may set, by section; every key is the command line option of the same name
+// except those of [traffic], which set the OnOffApplication defaults
+struct ScenarioKey {
+    const char *section;
+    const char *key;
+    const char *option;
+};
+
+static const ScenarioKey scenarioKeys[] = {
+    {"topology", "aps", "aps"}, {"topology", "apGridWidth", "apGridWidth"}, {"topology", "apSpacing", "apSpacing"},
+    {"topology", "wifiRange", "wifiRange"}, {"topology", "wifiChannel", "wifiChannel"}, {"topology", "discRate", "discRate"},
+    {"topology", "discDelay", "discDelay"}, {"topology", "robots", "robots"}, {"topology", "serverX", "serverX"},
+    {"topology", "serverY", "serverY"}, {"topology", "csmaDelay", "csmaDelay"}, {"topology", "backbone", "backbone"},
+    {"mobility", "robotSpeed", "robotSpeed"}, {"mobility", "robotFastSpeed", "robotFastSpeed"},
+    {"mobility", "fenceMinX", "fenceMinX"}, {"mobility", "fenceMinY", "fenceMinY"}, {"mobility", "fenceMaxX", "fenceMaxX"},
+    {"mobility", "fenceMaxY", "fenceMaxY"}, {"mobility", "homeX", "homeX"}, {"mobility", "homeY", "homeY"},
+    {"mobility", "homeTolerance", "homeTolerance"},
+    {"traffic", "packetSize", "ns3::OnOffApplication::PacketSize"}, {"traffic", "dataRate", "ns3::OnOffApplication::DataRate"},
+    {"traffic", "appStart", "appStart"},
+    {"events", "simulTime", "simulTime"}, {"events", "speedChangeTime", "speedChangeTime"},
+    {"events", "pingOffTime", "pingOffTime"}, {"events", "pingChangeTime", "pingChangeTime"}, {"events", "events", "events"},
+    {"graphs", "timeSeries", "timeSeries"}, {"graphs", "sweepRouting", "sweepRouting"}, {"graphs", "robotSweep", "robotSweep"},
+    {"probes", "binWidth", "binWidth"}, {"probes", "keepArrivalTimes", "keepArrivalTimes"}, {"probes", "overhead", "overhead"}, {"probes", "handover", "handover"},
+    {"probes", "robotCallbackLogging", "robotCallbackLogging"}, {"probes", "bench", "bench"}, {"probes", "benchFile", "benchFile"},
+    {"probes", "anim", "anim"}, {"probes", "animFile", "animFile"}, {"probes", "animStart", "animStart"},
+    {"probes", "animStop", "animStop"}, {"probes", "animMobilityInterval", "animMobilityInterval"},
+    {"probes", "animPackets", "animPackets"}, {"probes", "animMetadata", "animMetadata"}, {"probes", "animMaxMb", "animMaxMb"},
+    {"sweep", "graphs", "graphs"}, {"sweep", "robotCounts", "robotCounts"}, {"sweep", "sweepRates", "sweepRates"},
+    {"sweep", "sweepBudget", "sweepBudget"}, {"sweep", "sweepThreshold", "sweepThreshold"}, {"sweep", "runs", "runs"},
+    {"sweep", "targetRelErr", "targetRelErr"}, {"sweep", "maxRuns", "maxRuns"},
+    {"sweep", "steadyState", "steadyState"}, {"sweep", "steadyWindow", "steadyWindow"}, {"sweep", "steadyTolerance", "steadyTolerance"},
+    {"sweep", "steadyMinPackets", "steadyMinPackets"},
+    {"run", "jobs", "jobs"}, {"run", "run", "run"}, {"run", "cache", "cache"}, {"run", "warmStart", "warmStart"},
+    {"run", "scheduler", "scheduler"},
+};
+
+// Reads a scenario file into command line arguments. Unknown sections and keys, keys outside a section, keys given
+// twice and lines that are not key=value are reported with their line number; the values themselves are checked
+// by the command line parser and main() like any other argument.
+static bool loadScenario(const std::string &fileName, std::vector<std::string> &args) {
+    std::ifstream file(fileName.c_str());
+    if (!file) {
+        std::cerr << "cannot read scenario " << fileName << std::endl;
+        return false;
+    }
+
+    std::string line, section;
+    std::set<std::string> seen;
+    bool ok = true;
+    for (int number = 1; std::getline(file, line); ++number) {
+        // comments start with # or ;
+        size_t comment = line.find_first_of("#;");
+        if (comment != std::string::npos)
+            line.erase(comment);
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty())
+            continue;
+
+        std::ostringstream where;
+        where << fileName << ":" << number << ": ";
+        if (line[0] == '[') {
+            section = line[line.size() - 1] == ']' ? line.substr(1, line.size() - 2) : "";
+            bool known = false;
+            for (size_t k = 0; k < sizeof(scenarioKeys) / sizeof(scenarioKeys[0]); ++k)
+                known = known || section == scenarioKeys[k].section;
+            if (!known) {
+                std::cerr << where.str() << "unknown section " << line << std::endl;
+                ok = false;
+            }
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << where.str() << "expected key = value" << std::endl;
+            ok = false;
+            continue;
+        }
+        std::string key = line.substr(0, equals), value = line.substr(equals + 1);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+
+        const ScenarioKey *found = NULL;
+        for (size_t k = 0; k < sizeof(scenarioKeys) / sizeof(scenarioKeys[0]); ++k) {
+            if (section == scenarioKeys[k].section && key == scenarioKeys[k].key)
+                found = &scenarioKeys[k];
+        }
+        if (found == NULL) {
+            std::cerr << where.str() << "unknown key " << key << (section.empty() ? " outside of a section" : " in [" + section + "]") << std::endl;
+            ok = false;
+        } else if (!seen.insert(section + "." + key).second) {
+            std::cerr << where.str() << key << " is set twice" << std::endl;
+            ok = false;
+        } else {
+            args.push_back(std::string("--") + found->option + "=" + value);
+        }
+    }
+    return ok;
+}
+
+std::vector<int> parseList(const std::string &text) {
+    std::vector<int> values;
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ','))
+        values.push_back(atoi(item.c_str()));
+    return values;
+}
+
+std::vector<SimulationConfig> graphConfigurations(int graph) {
+    std::vector<SimulationConfig> configs;
+    SimulationConfig config;
+    if (graph < 1 || graph > 12) {
+        // a single run without a graph simulates the first time series
+        config = timeSeries.at(0);
+        config.nRobots = nRobots;
+        configs.push_back(config);
+    } else if (graph >= 1 && graph <= 8) {
+        config = timeSeries.at((graph - 1) % 4);
+        config.nRobots = nRobots;
+        configs.push_back(config);
+    } else if (graph == 9) {
+        config.olsrRouting = sweepRouting == "olsr";
+        config.nRobots = nRobots;
+        for (size_t i = 0; i < sweepRates.size(); ++i) {
+            config.dataRatekb = sweepRates[i];
+            configs.push_back(config);
+        }
+    } else if (graph >= 10 && graph <= 12) {
+        config = robotSweep;
+        for (size_t i = 0; i < robotCounts.size(); ++i) {
+            config.nRobots = robotCounts[i];
+            configs.push_back(config);
+        }
+    }
+    return configs;
+}
+
+// what the legend says about the configuration of a graph, e.g. OLSR 5Mbit
+static std::string graphLabel(int graph) {
+    if (graph == 9)
+        return sweepRouting == "olsr" ? "OLSR" : "AODV";
+    SimulationConfig config = graph <= 8 ? timeSeries.at((graph - 1) % 4) : robotSweep;
+    std::string rate = config.dataRatekb % 1000 == 0 ? std::to_string(config.dataRatekb / 1000) + "Mbit" : std::to_string(config.dataRatekb) + "kbit";
+    return (config.olsrRouting ? "OLSR " : "AODV ") + rate;
+}
+
+// routing:rate, e.g. aodv:50
+static bool parseConfig(const std::string &text, SimulationConfig &config) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos)
+        return false;
+    std::string routing = text.substr(0, colon), rate = text.substr(colon + 1);
+    char *end = NULL;
+    unsigned long long value = strtoull(rate.c_str(), &end, 10);
+    if ((routing != "olsr" && routing != "aodv") || rate.empty() || *end != '\0' || value == 0)
+        return false;
+    config.olsrRouting = routing == "olsr";
+    config.dataRatekb = value;
+    config.nRobots = nRobots;
+    return true;
+}
+
+// time:attribute=value,...; reports the first entry it cannot read
+static bool parseEvents(const std::string &text, std::vector<TimedEvent> &events) {
+    std::stringstream list(text);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        size_t colon = entry.find(':'), equals = entry.find('=');
+        TimedEvent event;
+        char *end = NULL;
+        if (colon != std::string::npos && equals != std::string::npos && colon < equals) {
+            std::string time = entry.substr(0, colon);
+            event.time = strtod(time.c_str(), &end);
+            event.attribute = entry.substr(colon + 1, equals - colon - 1);
+            event.value = entry.substr(equals + 1);
+        }
+        bool known = event.attribute == "speed" || event.attribute == "onTime" || event.attribute == "offTime" || event.attribute == "dataRate";
+        bool number = event.attribute == "dataRate" || (!event.value.empty() && strtod(event.value.c_str(), NULL) >= 0.0);
+        if (end == NULL || *end != '\0' || event.time < 0.0 || !known || event.value.empty() || !number) {
+            std::cerr << "cannot read event " << entry << ", expected time:attribute=value with speed, onTime, offTime or dataRate" << std::endl;
+            return false;
+        }
+        events.push_back(event);
+    }
+    return true;
+}
+
+bool sameConfig(const SimulationConfig &a, const SimulationConfig &b) {
+    return a.olsrRouting == b.olsrRouting && a.dataRatekb == b.dataRatekb && a.nRobots == b.nRobots;
+}
+
+// e.g. OLSR 5000 kbit, 1 robots
+static std::string configLabel(const SimulationConfig &config) {
+    return (config.olsrRouting ? "OLSR " : "AODV ") + std::to_string(config.dataRatekb) + " kbit, " + std::to_string(config.nRobots) + " robots";
+}
+
+size_t findConfig(const std::vector<SimulationConfig> &configs, const SimulationConfig &config) {
+    for (size_t c = 0; c < configs.size(); ++c) {
+        if (sameConfig(configs[c], config))
+            return c;
+    }
+    return configs.size();
+}
+
+void setupGraph(GraphOutput &graph, int id) {
+    graph.id = id;
+    graph.plot.SetOutputFilename("graf" + std::to_string(id) + ".svg");
+    graph.plot.SetTerminal("svg");
+    switch (id) {
+        case 1:
+        case 2:
         case 3:
-        case 7:
-            dataRatekb = 5000;
-            olsrRouting = false;
-            break;
         case 4:
+            setLabels(graph, "Graf zavislosti mnozstva prijatych datovych paketov od casu",
+                    "Cas [s]", "Mnozstvo prijatych paketov");
+            addPlotSeries(graph, "prijate pakety (" + graphLabel(id) + ")");
+            break;
+        case 5:
+        case 6:
+        case 7:
         case 8:
-            dataRatekb = 5;
-            olsrRouting = false;
+            setLabels(graph, "Graf zavislosti podielu prijatych datovych paketov ku vsetkym paketom v case",
+                    "Cas [s]", "podiel datove pakety ku vsetkym paketom");
+            addPlotSeries(graph, "goodput (" + graphLabel(id) + ")");
             break;
         case 9:
-            olsrRouting = false;
+            setLabels(graph, "Graf zavislosti poctu prijatych paketov od rychlosti ethernetovej linky",
+                    "Rychlost [bit/s]", "pocet prijatych paketov za celu simulaciu");
+            addPlotSeries(graph, "pocet paketov (" + graphLabel(id) + ")");
+            break;
+        case 10:
+            setLabels(graph, "Graf zavislosti poctu prijatych datovych paketov od poctu robotov",
+                    "Pocet robotov", "pocet prijatych datovych paketov za celu simulaciu");
+            addPlotSeries(graph, "prijate pakety (" + graphLabel(id) + ")");
+            break;
+        case 11:
+            setLabels(graph, "Graf zavislosti podielu prijatych datovych paketov ku vsetkym paketom od poctu robotov",
+                    "Pocet robotov", "podiel datove pakety ku vsetkym paketom");
+            addPlotSeries(graph, "goodput (" + graphLabel(id) + ")");
+            break;
+        case 12:
+            setLabels(graph, "Graf zavislosti oneskorenia datovych paketov od poctu robotov",
+                    "Pocet robotov", "oneskorenie [ms]");
+            addPlotSeries(graph, "p50 (" + graphLabel(id) + ")");
+            addPlotSeries(graph, "p99 (" + graphLabel(id) + ")");
+            addPlotSeries(graph, "p99.9 (" + graphLabel(id) + ")");
+            graph.percentiles.resize(graph.series.size());
+            for (size_t i = 0; i < graph.percentiles.size(); ++i) {
+                graph.percentiles[i].SetTitle(graph.series[i].title);
+                graph.percentiles[i].SetStyle(Gnuplot2dDataset::LINES_POINTS);
+            }
             break;
     }
-
-    int outerRuns = 1;
-    if (makeGraph == 9) {
-        outerRuns = 8;
-        bitRates.clear();
+    graph.plot.SetTitle(graph.title);
+    graph.plot.SetLegend(graph.xLabel, graph.yLabel);
+    if (graph.percentiles.empty())
+        graph.data.SetTitle(graph.series.at(0).title);
+
+    graph.logX = id >= 9;
+    graph.xMin = graph.xMax = 0.0;
+    if (id >= 1 && id <= 8)
+        graph.xMax = 32.0;
+    if (id == 9) {
+        graph.xMin = 1000.0;
+        graph.xMax = 5000000.0;
+    }
+    if (graph.logX)
+        graph.plot.AppendExtra("set logscale x");
+    if (graph.xMax > graph.xMin) {
+        std::ostringstream range;
+        range << std::setprecision(10) << "set xrange[" << graph.xMin << ":" << graph.xMax << "]";
+        graph.plot.AppendExtra(range.str());
     }
 
-    // Perform simulations
-    for (int outer = 0; outer < outerRuns; ++outer) {
-        if (makeGraph == 9) {
-            dataRatekb = pow(10.0, 0.5 * outer); // evenly spaces speeds (on log scale) from ~1kbit to ~5Mbit
-            bitRates.push_back(dataRatekb*1000);
-        }
+    graph.data.SetStyle(Gnuplot2dDataset::LINES); // use LINES_POINTS if you want to have errorbars with the line in one dataset
+    // Two lines because if the errorbars have the same color as the line it looks ugly
+    graph.errorBars.SetTitle("smerodajna odchylka");
+    graph.errorBars.SetStyle(Gnuplot2dDataset::POINTS);
+    graph.errorBars.SetErrorBars(Gnuplot2dDataset::Y);
+}
 
-        for (uint64_t i = 0; i < nRuns; i++) {
-            if (makeGraph >= 1 && makeGraph <= 8) {
-                packetsReceived = 0;
-                arrivalTimes.clear();
+// what graph plots for one replicate, one value per point
+std::vector<double> graphSeries(int graph, const ReplicateResult &result) {
+    std::vector<double> series;
+    if (graph == 9) {
+        series.push_back(steadyTotal(result.allPacketsTotal, result.allPacketsPerBin, result, result.endTime));
+    } else if (graph == 10) {
+        // the applications stop a second before the end
+        series.push_back(steadyTotal(result.packetsTotal, result.packetsPerBin, result, result.endTime - 1));
+    } else if (graph == 11) {
+        series.push_back(result.allPacketsTotal != 0 ? result.packetsTotal / (double) result.allPacketsTotal : 0);
+    } else if (graph == 12) {
+        LogHistogram delays;
+        delays.Reset();
+        delays.Merge(result.delayBuckets);
+        for (size_t i = 0; i < 3; ++i)
+            series.push_back(delays.Percentile(latencyPercentiles[i]) / 1000.0);
+    } else if (graph >= 5) {
+        // share of the application packets among all packets in every bin
+        std::vector<double> packets = steadyBins(result.packetsPerBin, result, result.endTime - 1);
+        std::vector<double> allPackets = steadyBins(result.allPacketsPerBin, result, result.endTime);
+        for (size_t j = 0; j < allPackets.size(); ++j) {
+            if (j < packets.size() && allPackets[j] != 0) {
+                series.push_back(packets[j] / allPackets[j]);
+            } else {
+                series.push_back(0);
             }
-            if (makeGraph >= 5 && makeGraph <= 9) {
-                allPacketsRecieved = 0;
-                allPacketsArrivalTimes.clear();
+        }
+    } else {
+        series = steadyBins(result.packetsPerBin, result, result.endTime - 1);
+    }
+    return series;
+}
+
+// Packets per bin in the last steadyWindow of a replicate stopped in steady state
+static double lastWindowMean(const std::vector<int> &bins) {
+    size_t width = std::min(bins.size(), std::max((size_t) 1, (size_t) llround(steadyWindow / binWidth)));
+    double window = 0.0;
+    for (size_t i = bins.size() - width; i < bins.size(); ++i)
+        window += bins[i];
+    return window / width;
+}
+
+// Total of a replicate stopped in steady state, continued with the rate of its last window up to until
+static double steadyTotal(uint64_t total, const std::vector<int> &bins, const ReplicateResult &result, double until) {
+    if (result.stopTime >= result.endTime || bins.empty())
+        return total;
+    return total + lastWindowMean(bins) / binWidth * std::max(0.0, until - result.stopTime);
+}
+
+// Bins of a replicate stopped in steady state, continued up to the end with the mean of its last window; the bins
+// from until on stay empty
+static std::vector<double> steadyBins(const std::vector<int> &bins, const ReplicateResult &result, double until) {
+    std::vector<double> series(bins.begin(), bins.end());
+    if (result.stopTime >= result.endTime || bins.empty())
+        return series;
+    double mean = lastWindowMean(bins);
+    size_t full = (size_t) ceil(result.endTime / binWidth - 1e-9);
+    for (size_t j = series.size(); j < full; ++j)
+        series.push_back(j * binWidth < until ? mean : 0.0);
+    return series;
+}
+
+void addSeries(std::vector<RunningStats> &points, const std::vector<double> &series) {
+    if (points.size() < series.size())
+        points.resize(series.size(), RunningStats());
+    for (size_t i = 0; i < series.size(); ++i)
+        points[i].Add(series[i]);
+}
+
+// Number of replicates after which the confidence interval of every point of every graph using the configuration
+// is narrower than targetRelErr, checked from runs replicates on; 0 if that did not happen yet
+size_t convergedRuns(const SimulationConfig &config, const std::vector<ReplicateResult> &results, const std::vector<size_t> &replicates) {
+    std::vector<std::vector<RunningStats> > points(graphs.size());
+    for (size_t i = 0; i < replicates.size(); ++i) {
+        bool converged = true;
+        for (size_t g = 0; g < graphs.size(); ++g) {
+            std::vector<SimulationConfig> needed = graphConfigurations(graphs[g]);
+            if (findConfig(needed, config) == needed.size())
+                continue;
+            addSeries(points[g], graphSeries(graphs[g], results[replicates[i]]));
+            for (size_t j = 0; j < points[g].size(); ++j) {
+                // bins after a replicate stopped in steady state are not required to converge
+                if (points[g][j].count < i + 1)
+                    continue;
+                if (points[g][j].HalfWidth() > targetRelErr * fabs(points[g][j].mean))
+                    converged = false;
             }
+        }
+        if (converged && i + 1 >= runs)
+            return i + 1;
+    }
+    return 0;
+}
+
+// The geometric middles of the sweep intervals whose ends differ by more than sweepThreshold of the curve's range,
+// or whose error bars are that wide together, steepest first and at most maxPoints of them
+std::vector<uint64_t> refineSweep(const std::vector<RunningStats> &points, size_t maxPoints) {
+    std::vector<uint64_t> rates;
+    if (points.size() < 2 || maxPoints == 0)
+        return rates;
+
+    double lowest = points[0].mean, highest = points[0].mean;
+    for (size_t p = 1; p < points.size(); ++p) {
+        lowest = std::min(lowest, points[p].mean);
+        highest = std::max(highest, points[p].mean);
+    }
+    if (highest <= lowest)
+        return rates;
+
+    std::vector<std::pair<double, uint64_t> > candidates;
+    for (size_t p = 0; p + 1 < points.size(); ++p) {
+        uint64_t middle = (uint64_t) llround(sqrt((double) sweepRates[p] * sweepRates[p + 1]));
+        if (middle <= sweepRates[p] || middle >= sweepRates[p + 1])
+            continue; // rates are whole kbit/s
+        double change = fabs(points[p + 1].mean - points[p].mean);
+        double overlap = points[p].StdDev() + points[p + 1].StdDev();
+        double score = std::max(change, overlap) / (highest - lowest);
+        if (score > sweepThreshold)
+            candidates.push_back(std::make_pair(score, middle));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (size_t i = candidates.size(); i-- > 0 && rates.size() < maxPoints;)
+        rates.push_back(candidates[i].second);
+    return rates;
+}
+
+void fillGnuplotData(GraphOutput &graph, const std::vector<RunningStats> &points, const std::vector<double> &xValues) {
+    for (size_t i = 0; i < points.size(); ++i) {
+        graph.data.Add(xValues[i], points[i].mean);
+        graph.errorBars.Add(xValues[i], points[i].mean, points[i].StdDev());
+        graph.series[0].x.push_back(xValues[i]);
+        graph.series[0].y.push_back(points[i].mean);
+        graph.series[0].deviation.push_back(points[i].StdDev());
+    }
+}
 
-            doSimulation(olsrRouting, dataRatekb, st);
+static void setLabels(GraphOutput &graph, const std::string &title, const std::string &xLabel, const std::string &yLabel) {
+    graph.title = title;
+    graph.xLabel = xLabel;
+    graph.yLabel = yLabel;
+}
 
-            if (makeGraph >= 1 && makeGraph <= 8)
-                aggregatePacketCount(arrivalTimes, packetsPerSec, i);
-            if (makeGraph >= 5 && makeGraph <= 8)
-                aggregatePacketCount(allPacketsArrivalTimes, allPacketsMeassurements, i);
-            if (makeGraph == 9)
-                allPacketsMeassurements[i].push_back(allPacketsArrivalTimes.size());
+static void addPlotSeries(GraphOutput &graph, const std::string &title) {
+    PlotSeries series;
+    series.title = title;
+    graph.series.push_back(series);
+}
+
+// Fills one graph from the replicates its configurations use
+static void buildGraph(GraphOutput &graph, const std::vector<SimulationConfig> &configs, const std::vector<size_t> &configRuns,
+        const std::vector<std::vector<size_t> > &configReplicates, const std::vector<ReplicateResult> &simulatedResults) {
+    // graphs 1-8 have one point per bin, graphs 9-11 one point per configuration
+    std::vector<SimulationConfig> needed = graphConfigurations(graph.id);
+    std::vector<RunningStats> points;
+    std::vector<double> xValues;
+    for (size_t c = 0; c < needed.size(); ++c) {
+        size_t config = findConfig(configs, needed[c]);
+        std::vector<RunningStats> configPoints;
+        for (size_t i = 0; i < configRuns[config]; ++i)
+            addSeries(configPoints, graphSeries(graph.id, simulatedResults[configReplicates[config][i]]));
+
+        if (graph.id == 12) {
+            // percentiles of the delays of all replicates together
+            LogHistogram delays;
+            delays.Reset();
+            for (size_t i = 0; i < configRuns[config]; ++i)
+                delays.Merge(simulatedResults[configReplicates[config][i]].delayBuckets);
+            for (size_t i = 0; i < graph.percentiles.size(); ++i) {
+                double delay = delays.Percentile(latencyPercentiles[i]) / 1000.0;
+                graph.percentiles[i].Add(needed[c].nRobots, delay);
+                graph.series[i].x.push_back(needed[c].nRobots);
+                graph.series[i].y.push_back(delay);
+            }
+        } else if (graph.id >= 9) {
+            points.push_back(configPoints.at(0));
+            xValues.push_back(graph.id == 9 ? needed[c].dataRatekb * 1000.0 : needed[c].nRobots);
+        } else {
+            points = configPoints;
+            for (size_t j = 0; j < points.size(); ++j)
+                xValues.push_back(j * binWidth);
         }
     }
 
     // add the correct data to the graf
-    if (makeGraph >= 1 && makeGraph <= 4)
-        fillGnuplotData(packetsPerSec);
-
-    if (makeGraph >= 5 && makeGraph <= 8) {
-        std::vector<double> quotient[10];
-        for (int i = 0; i < 10; ++i) {
-            for (int j = 0; j < allPacketsMeassurements[i].size(); ++j) {
-                if (j < packetsPerSec[i].size() && allPacketsMeassurements[i][j] != 0) {
-                    quotient[i].push_back(packetsPerSec[i][j] / (double) allPacketsMeassurements[i][j]);
-                } else {
-                    quotient[i].push_back(0);
-                }
+    fillGnuplotData(graph, points, xValues);
+
+    // zaverecne spustenie
+    if (graph.percentiles.empty()) {
+        graph.plot.AddDataset(graph.errorBars);
+        graph.plot.AddDataset(graph.data);
+    }
+    for (size_t i = 0; i < graph.percentiles.size(); ++i)
+        graph.plot.AddDataset(graph.percentiles[i]);
+}
+
+// one gnuplot process for a batch of graphs, reset between them so that settings of one graph do not leak into the next
+static pid_t startGnuplot(const std::vector<std::string> &plotFiles, const std::string &batchName) {
+    std::ofstream batch(batchName.c_str());
+    for (size_t i = 0; i < plotFiles.size(); ++i)
+        batch << "load \"" << plotFiles[i] << "\"" << std::endl << "reset" << std::endl;
+    batch.close();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execlp("gnuplot", "gnuplot", batchName.c_str(), (char *) NULL);
+        _exit(127);
+    }
+    if (pid < 0)
+        std::cerr << "cannot start gnuplot: " << strerror(errno) << std::endl;
+    return pid;
+}
+
+static std::string svgEscape(const std::string &text) {
+    std::string escaped;
+    for (size_t i = 0; i < text.size(); ++i) {
+        switch (text[i]) {
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '&': escaped += "&amp;"; break;
+            case '"': escaped += "&quot;"; break;
+            default: escaped += text[i];
+        }
+    }
+    return escaped;
+}
+
+// tick values of a linear axis, 1, 2 or 5 times a power of ten apart
+static std::vector<double> linearTicks(double low, double high) {
+    std::vector<double> ticks;
+    double raw = (high - low) / 6.0;
+    double step = pow(10.0, floor(log10(raw)));
+    if (raw / step >= 5.0)
+        step *= 5.0;
+    else if (raw / step >= 2.0)
+        step *= 2.0;
+    for (double tick = ceil(low / step) * step; tick <= high + step * 1e-9; tick += step)
+        ticks.push_back(fabs(tick) < step * 1e-9 ? 0.0 : tick);
+    return ticks;
+}
+
+// the same layout as the gnuplot svg terminal: lines, error bars of the mean, legend in the top right corner
+bool writeSvgGraph(const GraphOutput &graph, const std::string &fileName) {
+    const double width = 600.0, height = 480.0;
+    const double left = 80.0, right = 20.0, top = 40.0, bottom = 60.0;
+    const char *colors[] = {"#9400d3", "#009e73", "#56b4e9", "#e69f00", "#f0e442", "#0072b2"};
+    const size_t nColors = sizeof(colors) / sizeof(colors[0]);
+
+    // ranges of the axes, on a log x axis only positive values can be drawn
+    double xLow = graph.xMin, xHigh = graph.xMax;
+    double yLow = 0.0, yHigh = 0.0;
+    bool xFromData = !(graph.xMax > graph.xMin), first = true;
+    for (size_t s = 0; s < graph.series.size(); ++s) {
+        const PlotSeries &series = graph.series[s];
+        for (size_t i = 0; i < series.x.size(); ++i) {
+            if (graph.logX && series.x[i] <= 0.0)
+                continue;
+            double deviation = series.deviation.empty() ? 0.0 : series.deviation[i];
+            if (xFromData) {
+                xLow = first ? series.x[i] : std::min(xLow, series.x[i]);
+                xHigh = first ? series.x[i] : std::max(xHigh, series.x[i]);
+            }
+            yLow = std::min(yLow, series.y[i] - deviation);
+            yHigh = std::max(yHigh, series.y[i] + deviation);
+            first = false;
+        }
+    }
+    if (xHigh <= xLow) {
+        xLow = graph.logX ? xLow / 10.0 : xLow - 1.0;
+        xHigh = graph.logX ? xHigh * 10.0 : xHigh + 1.0;
+    }
+    if (yHigh <= yLow)
+        yHigh = yLow + 1.0;
+    if (graph.logX && xLow <= 0.0) {
+        std::cerr << "graph " << graph.id << " has a log x axis but no positive x values" << std::endl;
+        return false;
+    }
+    std::vector<double> yTicks = linearTicks(yLow, yHigh);
+    yLow = std::min(yLow, yTicks.front());
+    yHigh = std::max(yHigh, yTicks.back());
+
+    double plotWidth = width - left - right, plotHeight = height - top - bottom;
+    double xScaledLow = graph.logX ? log10(xLow) : xLow;
+    double xScaledHigh = graph.logX ? log10(xHigh) : xHigh;
+    auto xPixel = [&](double x) {
+        return left + ((graph.logX ? log10(x) : x) - xScaledLow) / (xScaledHigh - xScaledLow) * plotWidth;
+    };
+    auto yPixel = [&](double y) {
+        return top + plotHeight - (y - yLow) / (yHigh - yLow) * plotHeight;
+    };
+
+    std::ofstream out(fileName.c_str());
+    if (!out) {
+        std::cerr << "cannot write " << fileName << std::endl;
+        return false;
+    }
+    out << "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"no\"?>" << std::endl;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height
+        << "\" viewBox=\"0 0 " << width << " " << height << "\" font-family=\"Arial\" font-size=\"12\">" << std::endl;
+    out << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>" << std::endl;
+    out << "<text x=\"" << width / 2 << "\" y=\"" << top / 2 + 4 << "\" text-anchor=\"middle\">" << svgEscape(graph.title) << "</text>" << std::endl;
+
+    // ticks and grid of both axes
+    std::vector<double> xTicks;
+    if (graph.logX) {
+        for (double decade = pow(10.0, ceil(log10(xLow) - 1e-9)); decade <= xHigh * (1 + 1e-9); decade *= 10.0)
+            xTicks.push_back(decade);
+    } else {
+        xTicks = linearTicks(xLow, xHigh);
+    }
+    for (size_t i = 0; i < xTicks.size(); ++i) {
+        double x = xPixel(xTicks[i]);
+        out << "<line x1=\"" << x << "\" y1=\"" << top + plotHeight << "\" x2=\"" << x << "\" y2=\"" << top + plotHeight - 6
+            << "\" stroke=\"black\"/>" << std::endl;
+        out << "<text x=\"" << x << "\" y=\"" << top + plotHeight + 18 << "\" text-anchor=\"middle\">" << xTicks[i] << "</text>" << std::endl;
+    }
+    for (size_t i = 0; i < yTicks.size(); ++i) {
+        double y = yPixel(yTicks[i]);
+        out << "<line x1=\"" << left << "\" y1=\"" << y << "\" x2=\"" << left + 6 << "\" y2=\"" << y << "\" stroke=\"black\"/>" << std::endl;
+        out << "<text x=\"" << left - 8 << "\" y=\"" << y + 4 << "\" text-anchor=\"end\">" << yTicks[i] << "</text>" << std::endl;
+    }
+    out << "<rect x=\"" << left << "\" y=\"" << top << "\" width=\"" << plotWidth << "\" height=\"" << plotHeight
+        << "\" fill=\"none\" stroke=\"black\"/>" << std::endl;
+    out << "<text x=\"" << left + plotWidth / 2 << "\" y=\"" << height - 16 << "\" text-anchor=\"middle\">" << svgEscape(graph.xLabel) << "</text>" << std::endl;
+    out << "<text transform=\"translate(18," << top + plotHeight / 2 << ") rotate(-90)\" text-anchor=\"middle\">" << svgEscape(graph.yLabel) << "</text>" << std::endl;
+
+    // the series, clipped to the plot area
+    out << "<clipPath id=\"plot\"><rect x=\"" << left << "\" y=\"" << top << "\" width=\"" << plotWidth << "\" height=\"" << plotHeight << "\"/></clipPath>" << std::endl;
+    out << "<g clip-path=\"url(#plot)\" fill=\"none\">" << std::endl;
+    size_t color = 0;
+    std::vector<std::pair<std::string, const char *> > legend;
+    for (size_t s = 0; s < graph.series.size(); ++s) {
+        const PlotSeries &series = graph.series[s];
+        if (!series.deviation.empty()) {
+            // the error bars in their own color, as in the gnuplot graphs
+            const char *barColor = colors[color++ % nColors];
+            for (size_t i = 0; i < series.x.size(); ++i) {
+                if (graph.logX && series.x[i] <= 0.0)
+                    continue;
+                double x = xPixel(series.x[i]), low = yPixel(series.y[i] - series.deviation[i]), high = yPixel(series.y[i] + series.deviation[i]);
+                out << "<path d=\"M" << x << "," << low << "V" << high << "M" << x - 3 << "," << low << "h6M" << x - 3 << "," << high
+                    << "h6\" stroke=\"" << barColor << "\"/>" << std::endl;
+            }
+            legend.push_back(std::make_pair(std::string("smerodajna odchylka"), barColor));
+        }
+        const char *lineColor = colors[color++ % nColors];
+        out << "<polyline stroke=\"" << lineColor << "\" stroke-width=\"1.5\" points=\"";
+        for (size_t i = 0; i < series.x.size(); ++i) {
+            if (!graph.logX || series.x[i] > 0.0)
+                out << xPixel(series.x[i]) << "," << yPixel(series.y[i]) << " ";
+        }
+        out << "\"/>" << std::endl;
+        if (graph.percentiles.size() > 0) {
+            for (size_t i = 0; i < series.x.size(); ++i) {
+                if (!graph.logX || series.x[i] > 0.0)
+                    out << "<circle cx=\"" << xPixel(series.x[i]) << "\" cy=\"" << yPixel(series.y[i]) << "\" r=\"3\" stroke=\"" << lineColor << "\"/>" << std::endl;
             }
         }
-        fillGnuplotData(quotient);
+        legend.push_back(std::make_pair(series.title, lineColor));
+    }
+    out << "</g>" << std::endl;
+
+    for (size_t i = 0; i < legend.size(); ++i) {
+        double y = top + 16 + i * 16;
+        out << "<text x=\"" << left + plotWidth - 50 << "\" y=\"" << y + 4 << "\" text-anchor=\"end\">" << svgEscape(legend[i].first) << "</text>" << std::endl;
+        out << "<line x1=\"" << left + plotWidth - 42 << "\" y1=\"" << y << "\" x2=\"" << left + plotWidth - 10 << "\" y2=\"" << y
+            << "\" stroke=\"" << legend[i].second << "\" stroke-width=\"1.5\"/>" << std::endl;
+    }
+    out << "</svg>" << std::endl;
+    return true;
+}
+
+template <typename T>
+static void appendValue(std::string &buffer, const T &value) {
+    buffer.append((const char *) &value, sizeof(value));
+}
+
+template <typename T>
+static bool readValue(const std::string &buffer, size_t &offset, T &value) {
+    if (buffer.size() - offset < sizeof(value))
+        return false;
+    memcpy(&value, buffer.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+template <typename T>
+static void appendVector(std::string &buffer, const std::vector<T> &values) {
+    uint64_t size = values.size();
+    appendValue(buffer, size);
+    if (size > 0)
+        buffer.append((const char *) values.data(), size * sizeof(T));
+}
+
+template <typename T>
+static bool readVector(const std::string &buffer, size_t &offset, std::vector<T> &values) {
+    uint64_t size;
+    if (!readValue(buffer, offset, size))
+        return false;
+    if (size > (buffer.size() - offset) / sizeof(T))
+        return false;
+    values.resize(size);
+    if (size > 0)
+        memcpy(values.data(), buffer.data() + offset, size * sizeof(T));
+    offset += size * sizeof(T);
+    return true;
+}
+
+static bool decodeResult(const std::string &buffer, ReplicateResult &result) {
+    size_t offset = 0;
+    return readVector(buffer, offset, result.packetsPerBin)
+            && readVector(buffer, offset, result.allPacketsPerBin)
+            && readValue(buffer, offset, result.packetsTotal)
+            && readValue(buffer, offset, result.allPacketsTotal)
+            && readVector(buffer, offset, result.robotPacketsSent)
+            && readVector(buffer, offset, result.robotPacketsReceived)
+            && readVector(buffer, offset, result.arrivalTimes)
+            && readVector(buffer, offset, result.allPacketsArrivalTimes)
+            && readVector(buffer, offset, result.phases)
+            && readVector(buffer, offset, result.delayBuckets)
+            && readVector(buffer, offset, result.jitterBuckets)
+            && readValue(buffer, offset, result.packetsReordered)
+            && readVector(buffer, offset, result.overheadNodeFrames)
+            && readVector(buffer, offset, result.overheadNodeBytes)
+            && readVector(buffer, offset, result.overheadBinFrames)
+            && readVector(buffer, offset, result.overheadBinBytes)
+            && readVector(buffer, offset, result.handovers)
+            && readValue(buffer, offset, result.stopTime)
+            && readValue(buffer, offset, result.endTime)
+            && offset == buffer.size();
+}
+
+static std::string eventsKey() {
+    std::ostringstream key;
+    key << std::setprecision(17);
+    for (size_t e = 0; e < timedEvents.size(); ++e)
+        key << (e > 0 ? "," : "") << timedEvents[e].time << ":" << timedEvents[e].attribute << "=" << timedEvents[e].value;
+    return key.str();
+}
+
+static std::string attributeDefault(const std::string &typeName, const std::string &attribute) {
+    struct TypeId::AttributeInformation info;
+    if (!TypeId::LookupByName(typeName).LookupAttributeByName(attribute, &info))
+        return "";
+    return info.initialValue->SerializeToString(info.checker);
+}
+
+// Describes every input that influences the result of a replicate.
+// Attribute defaults are read back, so --ns3::OnOffApplication::... overrides are included as well.
+static std::string cacheKey(const SimulationTask &task, double simulationTime) {
+    std::ostringstream key;
+    key << std::setprecision(17)
+        << "format=6"
+        << " routing=" << (task.config.olsrRouting ? "olsr" : "aodv")
+        << " csmaRate=" << task.config.dataRatekb << "kb"
+        << " robots=" << task.config.nRobots
+        << " simTime=" << simulationTime
+        << " packetSize=" << attributeDefault("ns3::OnOffApplication", "PacketSize")
+        << " onOffRate=" << attributeDefault("ns3::OnOffApplication", "DataRate")
+        << " onTime=" << attributeDefault("ns3::OnOffApplication", "OnTime")
+        << " offTime=" << attributeDefault("ns3::OnOffApplication", "OffTime")
+        << " aps=" << nAps << "x" << apGridWidth << "@" << apSpacing
+        << " server=" << serverX << "," << serverY << " csmaDelay=" << csmaDelayMs << "ms"
+        << " appStart=" << appStartTime
+        << " wifiRange=" << wifiRange
+        << " wifiChannel=" << wifiChannel
+        << " disc=" << (wifiChannel == "disc" ? discRate + "," + std::to_string(discDelay) : "-")
+        << " fence=" << fenceMinX << "," << fenceMinY << "," << fenceMaxX << "," << fenceMaxY
+        << " home=" << homeX << "," << homeY << "," << homeTolerance
+        << " speed=" << robotSpeed
+        << " events=" << eventsKey()
+        << " binWidth=" << binWidth
+        << " arrivalTimes=" << keepArrivalTimes
+        << " seed=" << RngSeedManager::GetSeed()
+        << " run=" << firstRun + task.replicate
+        << " warmStart=" << (warmStart ? "prefixRun=" + std::to_string(firstRun) : "0") // the prefix is simulated with RNG run firstRun
+        << " overhead=" << doOverhead
+        << " handover=" << doHandover
+        << " backbone=" << backbone
+        << " steadyState=" << (steadyState ? std::to_string(steadyWindow) + "," + std::to_string(steadyTolerance) + "," + std::to_string(steadyMinPackets) : "-");
+    return key.str();
+}
+
+// FNV-1a, only used to name the cache files; the full key is stored inside and compared on load
+static uint64_t hashKey(const std::string &key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); ++i) {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211ULL;
     }
+    return hash;
+}
 
-    if (makeGraph == 9)
-        fillGnuplotData(allPacketsMeassurements, bitRates);
+static std::string cacheFileName(const std::string &key) {
+    std::ostringstream name;
+    name << cacheDir << "/" << std::hex << std::setw(16) << std::setfill('0') << hashKey(key) << ".bin";
+    return name.str();
+}
 
-    if (makeGraph) {
-        // zaverecne spustenie
-        graf.AddDataset(errorBars);
-        graf.AddDataset(data);
-        std::ofstream plotFile("graf" + std::to_string(makeGraph) + ".plt");
-        graf.GenerateOutput(plotFile);
-        plotFile.close();
-        std::string pltName = "gnuplot graf" + std::to_string(makeGraph) + ".plt";
-        if (system(pltName.c_str()));
+static bool loadCachedResult(const SimulationTask &task, double simulationTime, std::string &buffer) {
+    if (cacheDir.empty())
+        return false;
+
+    std::string key = cacheKey(task, simulationTime);
+    std::ifstream file(cacheFileName(key).c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t offset = 0;
+    std::vector<char> storedKey;
+    if (!readVector(contents, offset, storedKey) || std::string(storedKey.begin(), storedKey.end()) != key)
+        return false;
+    buffer = contents.substr(offset);
+    return true;
+}
+
+// Written under a temporary name first, so that a crash never leaves a truncated file behind
+static bool writeFileAtomically(const std::string &fileName, const std::string &contents) {
+    std::string tmpName = fileName + ".tmp" + std::to_string(getpid());
+    std::ofstream file(tmpName.c_str(), std::ios::binary);
+    file.write(contents.data(), contents.size());
+    file.close();
+    if (!file || rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        unlink(tmpName.c_str());
+        return false;
     }
-    return 0;
+    return true;
 }
 
-void aggregatePacketCount(std::vector<double> packetArrivalTimes, std::vector<int> meassurementsArray[], uint64_t index) {
-    int j = 0;
-    do{
-        for (int k = 0; k < simTime; k++) {
-            if (j == 0)
-                meassurementsArray[index].push_back(0);
-            if(packetArrivalTimes.size() > 0){
-                if (packetArrivalTimes[j] >= k && packetArrivalTimes[j] < k + 1) {
-                    meassurementsArray[index][k]++;
-                    if (j != 0)
-                        break;
-                }
+static void storeCachedResult(const SimulationTask &task, double simulationTime, const std::string &buffer) {
+    if (cacheDir.empty())
+        return;
+
+    if (mkdir(cacheDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror(cacheDir.c_str());
+        return;
+    }
+
+    std::string key = cacheKey(task, simulationTime);
+    std::string contents;
+    appendVector(contents, std::vector<char>(key.begin(), key.end()));
+    contents += buffer;
+
+    std::string fileName = cacheFileName(key);
+    if (!writeFileAtomically(fileName, contents))
+        std::cerr << "could not write cache entry " << fileName << std::endl;
+}
+
+// Columnar replicate files of --store: a header naming the configuration, replicate and RNG run, the scenario
+// description (the cache key), a table of columns and the columns themselves, each 8 byte aligned.
+// Readers map the file and only touch the columns they need.
+struct StoreHeader {
+    char magic[8]; // "ROBOCOL1"
+    uint32_t version;
+    uint32_t nColumns;
+    uint64_t olsrRouting;
+    uint64_t dataRatekb;
+    uint64_t nRobots;
+    uint64_t replicate;
+    uint64_t run;
+    uint64_t keyLength; // the scenario description follows the header
+};
+
+struct StoreColumn {
+    char name[24];
+    uint32_t type; // 1 int32, 2 uint64, 3 double
+    uint32_t elementSize;
+    uint64_t count;
+    uint64_t offset; // from the start of the file
+};
+
+static const char storeMagic[8] = {'R', 'O', 'B', 'O', 'C', 'O', 'L', '1'};
+
+static size_t aligned(size_t size) {
+    return (size + 7) & ~(size_t) 7;
+}
+
+template <typename T>
+static void appendColumn(std::vector<StoreColumn> &columns, std::string &data, const char *name, uint32_t type, const std::vector<T> &values) {
+    StoreColumn column;
+    memset(&column, 0, sizeof(column));
+    strncpy(column.name, name, sizeof(column.name) - 1);
+    column.type = type;
+    column.elementSize = sizeof(T);
+    column.count = values.size();
+    column.offset = data.size(); // relative to the data until the file is put together
+    columns.push_back(column);
+    data.append((const char *) values.data(), values.size() * sizeof(T));
+    data.resize(aligned(data.size()), '\0');
+}
+
+static std::string storeFileName(const std::string &dir, const SimulationTask &task) {
+    std::ostringstream name;
+    name << dir << "/" << (task.config.olsrRouting ? "olsr-" : "aodv-") << task.config.dataRatekb << "kb-" << task.config.nRobots
+         << "r-run" << firstRun + task.replicate << ".col";
+    return name.str();
+}
+
+static void writeStoredResult(const SimulationTask &task, const ReplicateResult &result, double simulationTime) {
+    if (mkdir(storeDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror(storeDir.c_str());
+        return;
+    }
+
+    std::vector<uint64_t> totals;
+    totals.push_back(result.packetsTotal);
+    totals.push_back(result.allPacketsTotal);
+    totals.push_back(result.packetsReordered);
+
+    std::vector<StoreColumn> columns;
+    std::string data;
+    appendColumn(columns, data, "packetsPerBin", 1, result.packetsPerBin);
+    appendColumn(columns, data, "allPacketsPerBin", 1, result.allPacketsPerBin);
+    appendColumn(columns, data, "totals", 2, totals);
+    appendColumn(columns, data, "robotPacketsSent", 2, result.robotPacketsSent);
+    appendColumn(columns, data, "robotPacketsReceived", 2, result.robotPacketsReceived);
+    appendColumn(columns, data, "delayBuckets", 2, result.delayBuckets);
+    appendColumn(columns, data, "jitterBuckets", 2, result.jitterBuckets);
+    appendColumn(columns, data, "arrivalTimes", 3, result.arrivalTimes);
+    appendColumn(columns, data, "allPacketsArrivalTimes", 3, result.allPacketsArrivalTimes);
+    std::vector<double> times;
+    times.push_back(result.stopTime);
+    times.push_back(result.endTime);
+    appendColumn(columns, data, "times", 3, times);
+    appendColumn(columns, data, "overheadNodeFrames", 2, result.overheadNodeFrames);
+    appendColumn(columns, data, "overheadNodeBytes", 2, result.overheadNodeBytes);
+    appendColumn(columns, data, "overheadBinFrames", 2, result.overheadBinFrames);
+    appendColumn(columns, data, "overheadBinBytes", 2, result.overheadBinBytes);
+    std::vector<double> handoverTimes, handoverOutages, handoverFirstDeliveries;
+    std::vector<uint64_t> handoverRobots, handoverChanges, handoverControlFrames;
+    for (size_t i = 0; i < result.handovers.size(); ++i) {
+        handoverTimes.push_back(result.handovers[i].time);
+        handoverRobots.push_back(result.handovers[i].robot);
+        handoverChanges.push_back(result.handovers[i].changes);
+        handoverOutages.push_back(result.handovers[i].outage);
+        handoverFirstDeliveries.push_back(result.handovers[i].firstDelivery);
+        handoverControlFrames.push_back(result.handovers[i].controlFrames);
+    }
+    appendColumn(columns, data, "handoverTimes", 3, handoverTimes);
+    appendColumn(columns, data, "handoverRobots", 2, handoverRobots);
+    appendColumn(columns, data, "handoverChanges", 2, handoverChanges);
+    appendColumn(columns, data, "handoverOutages", 3, handoverOutages);
+    appendColumn(columns, data, "handoverFirstDeliveries", 3, handoverFirstDeliveries);
+    appendColumn(columns, data, "handoverControlFrames", 2, handoverControlFrames);
+
+    std::string key = cacheKey(task, simulationTime);
+    StoreHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, storeMagic, sizeof(header.magic));
+    header.version = 2;
+    header.nColumns = columns.size();
+    header.olsrRouting = task.config.olsrRouting;
+    header.dataRatekb = task.config.dataRatekb;
+    header.nRobots = task.config.nRobots;
+    header.replicate = task.replicate;
+    header.run = firstRun + task.replicate;
+    header.keyLength = key.size();
+
+    size_t dataStart = aligned(sizeof(header) + key.size()) + columns.size() * sizeof(StoreColumn);
+    for (size_t i = 0; i < columns.size(); ++i)
+        columns[i].offset += dataStart;
+    std::string contents((const char *) &header, sizeof(header));
+    contents += key;
+    contents.resize(aligned(contents.size()), '\0');
+    contents.append((const char *) columns.data(), columns.size() * sizeof(StoreColumn));
+    contents += data;
+
+    std::string fileName = storeFileName(storeDir, task);
+    if (!writeFileAtomically(fileName, contents))
+        std::cerr << "could not write " << fileName << std::endl;
+}
+
+template <typename T>
+static bool mappedColumn(const char *file, size_t size, const StoreColumn *columns, uint32_t nColumns, const char *name, std::vector<T> &values) {
+    for (uint32_t i = 0; i < nColumns; ++i) {
+        if (strncmp(columns[i].name, name, sizeof(columns[i].name)) != 0)
+            continue;
+        if (columns[i].elementSize != sizeof(T) || columns[i].offset > size || columns[i].count > (size - columns[i].offset) / sizeof(T))
+            return false;
+        const T *first = (const T *) (file + columns[i].offset);
+        values.assign(first, first + columns[i].count);
+        return true;
+    }
+    return false;
+}
+
+// Maps one stored replicate and reads the columns the graphs and reports need; the raw arrival times are
+// only read with keepArrivalTimes
+static bool readStoredResult(const std::string &fileName, SimulationTask &task, uint64_t &run, std::string &key, ReplicateResult &result) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(StoreHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const char *file = (const char *) mapping;
+    StoreHeader header;
+    memcpy(&header, file, sizeof(header));
+    bool ok = memcmp(header.magic, storeMagic, sizeof(storeMagic)) == 0 && (header.version == 2 || (header.version == 1 && !doOverhead && !doHandover)) // version 1 has no overhead and handovers
+            && header.keyLength <= size - sizeof(header)
+            && aligned(sizeof(header) + header.keyLength) <= size // the column table starts there
+            && header.nColumns <= (size - aligned(sizeof(header) + header.keyLength)) / sizeof(StoreColumn);
+    if (ok) {
+        task.config.olsrRouting = header.olsrRouting != 0;
+        task.config.dataRatekb = header.dataRatekb;
+        task.config.nRobots = header.nRobots;
+        task.replicate = header.replicate;
+        run = header.run;
+        key.assign(file + sizeof(header), header.keyLength);
+
+        const StoreColumn *columns = (const StoreColumn *) (file + aligned(sizeof(header) + header.keyLength));
+        std::vector<uint64_t> totals;
+        result = ReplicateResult();
+        ok = mappedColumn(file, size, columns, header.nColumns, "packetsPerBin", result.packetsPerBin)
+                && mappedColumn(file, size, columns, header.nColumns, "allPacketsPerBin", result.allPacketsPerBin)
+                && mappedColumn(file, size, columns, header.nColumns, "totals", totals) && totals.size() == 3
+                && mappedColumn(file, size, columns, header.nColumns, "robotPacketsSent", result.robotPacketsSent)
+                && mappedColumn(file, size, columns, header.nColumns, "robotPacketsReceived", result.robotPacketsReceived)
+                && mappedColumn(file, size, columns, header.nColumns, "delayBuckets", result.delayBuckets)
+                && mappedColumn(file, size, columns, header.nColumns, "jitterBuckets", result.jitterBuckets)
+                && (!keepArrivalTimes
+                    || (mappedColumn(file, size, columns, header.nColumns, "arrivalTimes", result.arrivalTimes)
+                        && mappedColumn(file, size, columns, header.nColumns, "allPacketsArrivalTimes", result.allPacketsArrivalTimes)));
+        if (ok) {
+            result.packetsTotal = totals[0];
+            result.allPacketsTotal = totals[1];
+            result.packetsReordered = totals[2];
+            // files written before steady state stops have no times; their replicates ran to the end
+            std::vector<double> times;
+            if (mappedColumn(file, size, columns, header.nColumns, "times", times) && times.size() == 2) {
+                result.stopTime = times[0];
+                result.endTime = times[1];
+            }
+            if (doOverhead) {
+                ok = mappedColumn(file, size, columns, header.nColumns, "overheadNodeFrames", result.overheadNodeFrames)
+                        && mappedColumn(file, size, columns, header.nColumns, "overheadNodeBytes", result.overheadNodeBytes)
+                        && mappedColumn(file, size, columns, header.nColumns, "overheadBinFrames", result.overheadBinFrames)
+                        && mappedColumn(file, size, columns, header.nColumns, "overheadBinBytes", result.overheadBinBytes);
+            }
+            std::vector<double> handoverTimes, handoverOutages, handoverFirstDeliveries;
+            std::vector<uint64_t> handoverRobots, handoverChanges, handoverControlFrames;
+            if (ok && doHandover) {
+                ok = mappedColumn(file, size, columns, header.nColumns, "handoverTimes", handoverTimes)
+                        && mappedColumn(file, size, columns, header.nColumns, "handoverRobots", handoverRobots)
+                        && mappedColumn(file, size, columns, header.nColumns, "handoverChanges", handoverChanges)
+                        && mappedColumn(file, size, columns, header.nColumns, "handoverOutages", handoverOutages)
+                        && mappedColumn(file, size, columns, header.nColumns, "handoverFirstDeliveries", handoverFirstDeliveries)
+                        && mappedColumn(file, size, columns, header.nColumns, "handoverControlFrames", handoverControlFrames)
+                        && handoverRobots.size() == handoverTimes.size() && handoverChanges.size() == handoverTimes.size()
+                        && handoverOutages.size() == handoverTimes.size() && handoverFirstDeliveries.size() == handoverTimes.size()
+                        && handoverControlFrames.size() == handoverTimes.size();
             }
+            for (size_t i = 0; ok && i < handoverTimes.size(); ++i) {
+                HandoverEvent event;
+                event.time = handoverTimes[i];
+                event.robot = handoverRobots[i];
+                event.changes = handoverChanges[i];
+                event.outage = handoverOutages[i];
+                event.firstDelivery = handoverFirstDeliveries[i];
+                event.controlFrames = handoverControlFrames[i];
+                result.handovers.push_back(event);
+            }
+            result.fromCache = true; // not measured by this run
         }
-        j++;
-    } while(j < packetArrivalTimes.size());
+    }
+    munmap(mapping, size);
+    return ok;
+}
+
+// Replicates stored with their arrival times serve runs without them as well. The key is rebuilt with the RNG
+// runs of the invocation that stored the file, so that batches stored with different --run add up.
+static bool sameStoredScenario(const std::string &key, const SimulationTask &task, uint64_t run, double simulationTime) {
+    uint64_t currentFirstRun = firstRun;
+    firstRun = run - task.replicate;
+    bool same = key == cacheKey(task, simulationTime);
+    if (!same && !keepArrivalTimes) {
+        keepArrivalTimes = true;
+        same = key == cacheKey(task, simulationTime);
+        keepArrivalTimes = false;
+    }
+    firstRun = currentFirstRun;
+    return same;
 }
 
-void fillGnuplotData(std::vector<int> meassurements[]) {
-    // convert the integers to doubles and call the other function
-    std::vector<double> doubles[10];
-    for (int i = 0; i < 10; ++i) {
-        doubles[i] = std::vector<double>(meassurements[i].begin(), meassurements[i].end());
+// Collects the stored replicates of every configuration, in RNG run order. Files of other configurations are
+// ignored, files of the same configuration but a different scenario (any other option) are skipped and counted.
+static bool loadStore(const std::vector<SimulationConfig> &configs, double simulationTime, std::vector<SimulationTask> &tasks,
+        std::vector<ReplicateResult> &results, std::vector<std::vector<size_t> > &configReplicates) {
+    DIR *dir = opendir(aggregateDir.c_str());
+    if (dir == NULL) {
+        perror(aggregateDir.c_str());
+        return false;
+    }
+    std::vector<std::string> names;
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".col") == 0)
+            names.push_back(aggregateDir + "/" + name);
     }
-    fillGnuplotData(doubles);
+    closedir(dir);
+
+    size_t otherScenario = 0, unreadable = 0;
+    std::vector<std::pair<uint64_t, size_t> > order; // RNG run, index into tasks
+    for (size_t i = 0; i < names.size(); ++i) {
+        SimulationTask task;
+        ReplicateResult result;
+        uint64_t run = 0;
+        std::string key;
+        if (!readStoredResult(names[i], task, run, key, result)) {
+            ++unreadable;
+        } else if (findConfig(configs, task.config) == configs.size()) {
+            continue;
+        } else if (!sameStoredScenario(key, task, run, simulationTime)) {
+            ++otherScenario;
+        } else {
+            order.push_back(std::make_pair(run, tasks.size()));
+            tasks.push_back(task);
+            results.push_back(result);
+        }
+    }
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i)
+        configReplicates[findConfig(configs, tasks[order[i].second].config)].push_back(order[i].second);
+
+    std::cout << tasks.size() << " replicates read from " << aggregateDir;
+    if (otherScenario > 0 || unreadable > 0)
+        std::cout << " (" << otherScenario << " of another scenario and " << unreadable << " unreadable skipped)";
+    std::cout << std::endl;
+    for (size_t c = 0; c < configs.size(); ++c) {
+        if (configReplicates[c].empty()) {
+            std::cerr << "no stored replicates of " << configLabel(configs[c]) << " in " << aggregateDir << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs inside the forked worker: simulates one replicate and writes its results into the pipe.
+static void resetMeasurements(double simulationTime) {
+    packetsReceived = 0;
+    packetsHistogram.Reset(binWidth, simulationTime);
+    arrivalTimes.clear();
+    allPacketsRecieved = 0;
+    allPacketsHistogram.Reset(binWidth, simulationTime);
+    allPacketsArrivalTimes.clear();
+    benchPhases.assign(N_WORKER_PHASES, PhaseMeasurement());
+    delayHistogram.Reset();
+    jitterHistogram.Reset();
+    packetsReordered = 0;
+    overhead = OverheadCounters();
+    handovers.clear();
+    routingFramesSent = 0;
 }
 
-void fillGnuplotData(std::vector<double> meassurements[]) {
-    std::vector<double> xVals;
-    for (int i = 0; i < meassurements[0].size(); ++i) {
-        xVals.push_back((double) i);
+static bool runWorker(const SimulationTask &task, double simulationTime, int fd) {
+    RngSeedManager::SetRun(firstRun + task.replicate);
+
+    if (warmStart) {
+        // the converged simulation was inherited from the parent, the replicate diverges from here on
+        assignStreams(task.config);
+        runSim(simulationTime);
+    } else {
+        resetMeasurements(simulationTime);
+        doSimulation(task.config, simulationTime);
+    }
+
+    // only the bins simulated before a steady state stop are measured
+    if (replicateStopTime < simulationTime) {
+        size_t done = (size_t) (replicateStopTime / binWidth + 1e-9);
+        packetsHistogram.bins.resize(std::min(done, packetsHistogram.bins.size()));
+        allPacketsHistogram.bins.resize(std::min(done, allPacketsHistogram.bins.size()));
     }
-    fillGnuplotData(meassurements, xVals);
+
+    std::string buffer;
+    appendVector(buffer, packetsHistogram.bins);
+    appendVector(buffer, allPacketsHistogram.bins);
+    appendValue(buffer, packetsHistogram.total);
+    appendValue(buffer, allPacketsHistogram.total);
+    std::vector<uint64_t> robotPacketsSent, robotPacketsReceived;
+    for (size_t i = 0; i < robots.size(); ++i) {
+        robotPacketsSent.push_back(robots[i].packetsSent);
+        robotPacketsReceived.push_back(robots[i].packetsReceived);
+    }
+    appendVector(buffer, robotPacketsSent);
+    appendVector(buffer, robotPacketsReceived);
+    appendVector(buffer, arrivalTimes);
+    appendVector(buffer, allPacketsArrivalTimes);
+    appendVector(buffer, benchPhases);
+    appendVector(buffer, delayHistogram.Used());
+    appendVector(buffer, jitterHistogram.Used());
+    appendValue(buffer, packetsReordered);
+    appendVector(buffer, overhead.nodeFrames);
+    appendVector(buffer, overhead.nodeBytes);
+    appendVector(buffer, overhead.binFrames);
+    appendVector(buffer, overhead.binBytes);
+    finishHandovers(replicateStopTime);
+    appendVector(buffer, handovers);
+    appendValue(buffer, replicateStopTime);
+    appendValue(buffer, simulationTime);
+
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        written += n;
+    }
+    return true;
 }
 
-void fillGnuplotData(std::vector<int> meassurements[], std::vector<double> xValues) {
-    std::vector<double> doubles[10];
-    for (int i = 0; i < 10; ++i) {
-        doubles[i] = std::vector<double>(meassurements[i].begin(), meassurements[i].end());
+bool runReplicates(const std::vector<SimulationTask> &tasks, double simulationTime, std::vector<ReplicateResult> &results) {
+    results.assign(tasks.size(), ReplicateResult());
+
+    // replicates found in the cache are not simulated again
+    std::vector<size_t> pending;
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        std::string cached;
+        if (loadCachedResult(tasks[t], simulationTime, cached) && decodeResult(cached, results[t]))
+            results[t].fromCache = true;
+        else
+            pending.push_back(t);
+    }
+
+    bool ok = true;
+    if (!warmStart) {
+        ok = runPool(tasks, pending, simulationTime, results);
+    } else {
+        // every configuration converges once in this process, its replicates are forked from there
+        std::vector<bool> done(pending.size(), false);
+        for (size_t i = 0; ok && i < pending.size(); ++i) {
+            if (done[i])
+                continue;
+            std::vector<size_t> group;
+            for (size_t j = i; j < pending.size(); ++j) {
+                if (!done[j] && sameConfig(tasks[pending[i]].config, tasks[pending[j]].config)) {
+                    group.push_back(pending[j]);
+                    done[j] = true;
+                }
+            }
+            RngSeedManager::SetRun(firstRun);
+            resetMeasurements(simulationTime);
+            doSimulation(tasks[pending[i]].config, simulationTime, true);
+            ok = runPool(tasks, group, simulationTime, results);
+            Simulator::Destroy();
+        }
     }
-    fillGnuplotData(doubles, xValues);
+
+    if (!cacheDir.empty())
+        std::cout << tasks.size() - pending.size() << " of " << tasks.size() << " replicates loaded from " << cacheDir << std::endl;
+    return ok;
 }
 
-void fillGnuplotData(std::vector<double> meassurements[], std::vector<double> xValues) {
-    for (int i = 0; i < meassurements[0].size(); ++i) {
-        double average = 0.0;
-        for (int j = 0; j < 10; ++j) {
-            average += meassurements[j].at(i);
+// Runs the given tasks in a pool of nJobs worker processes
+static bool runPool(const std::vector<SimulationTask> &tasks, const std::vector<size_t> &pending, double simulationTime, std::vector<ReplicateResult> &results) {
+    struct Worker {
+        pid_t pid;
+        int fd;
+        size_t task;
+        std::string buffer;
+    };
+    std::vector<Worker> workers;
+    size_t next = 0;
+    bool ok = true;
+
+    while ((ok && next < pending.size()) || !workers.empty()) {
+        // keep the pool full
+        while (ok && next < pending.size() && workers.size() < (size_t) nJobs) {
+            size_t nextTask = pending[next];
+            int fds[2];
+            if (pipe(fds) != 0) {
+                perror("pipe");
+                ok = false;
+                break;
+            }
+
+            // anything still buffered would otherwise be printed by the child too
+            std::cout.flush();
+            std::cerr.flush();
+
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                close(fds[0]);
+                close(fds[1]);
+                ok = false;
+                break;
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                for (size_t i = 0; i < workers.size(); ++i)
+                    close(workers[i].fd);
+                bool written = runWorker(tasks[nextTask], simulationTime, fds[1]);
+                close(fds[1]);
+                std::cout.flush();
+                std::cerr.flush();
+                _exit(written ? 0 : 1);
+            }
+
+            close(fds[1]);
+            Worker worker = {pid, fds[0], nextTask, ""};
+            workers.push_back(worker);
+            ++next;
         }
-        average /= 10;
+        if (workers.empty())
+            break;
 
-        double deviation = 0.0;
-        for (int j = 0; j < 10; ++j) {
-            double k = meassurements[j].at(i) - average;
-            deviation += k*k;
+        std::vector<struct pollfd> pollFds(workers.size());
+        for (size_t i = 0; i < workers.size(); ++i) {
+            pollFds[i].fd = workers[i].fd;
+            pollFds[i].events = POLLIN;
+            pollFds[i].revents = 0;
+        }
+        if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            for (size_t i = 0; i < workers.size(); ++i) {
+                kill(workers[i].pid, SIGKILL);
+                close(workers[i].fd);
+                waitpid(workers[i].pid, NULL, 0);
+            }
+            return false;
         }
-        deviation /= 10;
-        deviation = sqrt(deviation);
 
-        data.Add(xValues[i], average);
-        errorBars.Add(xValues[i], average, deviation);
+        // backwards, so that erasing a finished worker does not shift the ones still to be checked
+        for (size_t i = workers.size(); i-- > 0;) {
+            if (!(pollFds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            char chunk[65536];
+            ssize_t n = read(workers[i].fd, chunk, sizeof(chunk));
+            if (n > 0) {
+                workers[i].buffer.append(chunk, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            // end of stream, the worker is done
+            close(workers[i].fd);
+            int status = 0;
+            while (waitpid(workers[i].pid, &status, 0) < 0 && errno == EINTR);
+
+            const SimulationTask &task = tasks[workers[i].task];
+            if (n < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+                    || !decodeResult(workers[i].buffer, results[workers[i].task])) {
+                std::cerr << "replicate " << task.replicate << " (RNG run " << firstRun + task.replicate << ") failed" << std::endl;
+                ok = false;
+            } else {
+                storeCachedResult(task, simulationTime, workers[i].buffer);
+            }
+            workers.erase(workers.begin() + i);
+        }
     }
-}
\ No newline at end of file
+    return ok;
+}